@@ -18,6 +18,155 @@
 uint8_t WiFiManager::_lastconxresulttmp = WL_IDLE_STATUS;
 #endif
 
+// fnv-1a, used for small lookup tables (probes)
+static uint32_t WM_hash(const char *str){
+  uint32_t h = 2166136261UL;
+  while(*str) h = (h ^ (uint8_t)*str++) * 16777619UL;
+  return h;
+}
+
+static uint32_t WM_hash_P(PGM_P str){
+  uint32_t h = 2166136261UL;
+  uint8_t c;
+  while((c = pgm_read_byte(str++))) h = (h ^ c) * 16777619UL;
+  return h;
+}
+
+// open addressed slot table over a PROGMEM table whose entries start with a PGM_P path
+// slots hold entry index+1, mask is slot count-1 (power of 2, well above entry count)
+static void WM_slotsBuild(uint8_t *slots, uint8_t mask, const void *table, size_t stride, uint8_t count){
+  for(uint8_t i = 0; i < count; i++){
+    uint8_t slot = WM_hash_P((PGM_P)pgm_read_ptr((const uint8_t*)table + i * stride)) & mask;
+    while(slots[slot]) slot = (slot + 1) & mask;
+    slots[slot] = i + 1;
+  }
+}
+
+// @return entry index or -1
+static int WM_slotsFind(const uint8_t *slots, uint8_t mask, const void *table, size_t stride, const char *path){
+  uint8_t slot = WM_hash(path) & mask;
+  while(slots[slot]){
+    uint8_t i = slots[slot] - 1;
+    if(strcmp_P(path, (PGM_P)pgm_read_ptr((const uint8_t*)table + i * stride)) == 0) return i;
+    slot = (slot + 1) & mask;
+  }
+  return -1;
+}
+
+// shortest fixed point text that reads back as value, bounds must not be rounded
+static String WM_floatOut(float value){
+  String out;
+  for(uint8_t d = 0; d <= 9; d++){
+    out = String(value, d);
+    if(strtof(out.c_str(), NULL) == value) break;
+  }
+  return out;
+}
+
+// html escape, for text and quoted attributes
+static void WM_htmlOut(String &out, const char *str){
+  for(; *str; str++){
+    switch(*str){
+      case '&':  out += F("&amp;"); break;
+      case '<':  out += F("&lt;"); break;
+      case '>':  out += F("&gt;"); break;
+      case '\'': out += F("&#39;"); break;
+      case '"':  out += F("&quot;"); break;
+      default:   out += *str;
+    }
+  }
+}
+
+// param groups are equal by name, NULL is the ungrouped group
+static bool WM_groupEq(const char *a, const char *b){
+  if(!a || !b) return a == b;
+  return a == b || strcmp(a, b) == 0;
+}
+
+// portal routes, dispatched from the not found handler by path hash, see dispatchRoute
+// /u (ota upload) is registered on the server, it needs an upload handler
+typedef enum {
+  WM_R_ROOT, WM_R_WIFI, WM_R_WIFINOSCAN, WM_R_WIFISAVE, WM_R_INFO, WM_R_PARAM, WM_R_PARAMSAVE,
+  WM_R_RESTART, WM_R_EXIT, WM_R_CLOSE, WM_R_ERASE, WM_R_STATUS, WM_R_UPDATE,
+  WM_R_TRACE, WM_R_HEAP, WM_R_METRICS, WM_R_LATENCY, WM_R_CONFIGEXPORT, WM_R_CONFIGIMPORT
+} wm_dispatch_t;
+
+typedef struct {
+  PGM_P   path;
+  uint8_t id;
+} wm_dispatch_route_t;
+
+static const wm_dispatch_route_t WM_DISPATCH[] PROGMEM = {
+  {R_root,       WM_R_ROOT},
+  {R_wifi,       WM_R_WIFI},
+  {R_wifinoscan, WM_R_WIFINOSCAN},
+  {R_wifisave,   WM_R_WIFISAVE},
+  {R_info,       WM_R_INFO},
+  {R_param,      WM_R_PARAM},
+  {R_paramsave,  WM_R_PARAMSAVE},
+  {R_restart,    WM_R_RESTART},
+  {R_exit,       WM_R_EXIT},
+  {R_close,      WM_R_CLOSE},
+  {R_erase,      WM_R_ERASE},
+  {R_status,     WM_R_STATUS},
+  {R_update,     WM_R_UPDATE},
+  #ifdef WM_TRACE
+  {R_trace,      WM_R_TRACE},
+  #endif
+  #ifdef WM_HEAPSTATS
+  {R_heap,       WM_R_HEAP},
+  #endif
+  #ifdef WM_METRICS
+  {R_metrics,    WM_R_METRICS},
+  #endif
+  #ifdef WM_LATENCY
+  {R_latency,    WM_R_LATENCY},
+  #endif
+  #ifdef WM_CONFIGIO
+  {R_configexport, WM_R_CONFIGEXPORT},
+  {R_configimport, WM_R_CONFIGIMPORT},
+  #endif
+};
+static const uint8_t _numdispatch = sizeof(WM_DISPATCH) / sizeof(wm_dispatch_route_t);
+
+#ifdef WM_STREAMFORM
+/**
+ * Streaming form body
+ * application/x-www-form-urlencoded POSTs to wifisave and paramsave are read in raw chunks
+ * instead of the server collecting every arg as Strings, fields are decoded incrementally into one
+ * buffer sized to the largest param, param fields are stored as they complete,
+ * other fields (ssid, password, static ip ..) are kept for argValue()
+ */
+class WiFiManagerFormHandler : public RequestHandler {
+  public:
+    WiFiManagerFormHandler(WiFiManager *wm) : _wm(wm) {}
+
+    bool canHandle(HTTPMethod method, const String &uri) override {
+      return method == HTTP_POST && canRaw(uri);
+    }
+    bool canRaw(const String &uri) override {
+      return strcmp_P(uri.c_str(), R_paramsave) == 0 || strcmp_P(uri.c_str(), R_wifisave) == 0;
+    }
+    void raw(ESP8266WebServer &server, const String &uri, HTTPRaw &raw) override {
+      _wm->formRaw(raw);
+    }
+    bool handle(ESP8266WebServer &server, HTTPMethod method, const String &uri) override {
+      _wm->dispatchRoute();
+      _wm->formEnd();
+      return true;
+    }
+
+  private:
+    WiFiManager *_wm;
+};
+
+#endif
+
+#ifdef WM_TRACE
+wm_trace_span_t WiFiManager::_trace[WM_TRACE_SIZE];
+uint8_t WiFiManager::_traceCount = 0;
+#endif
+
 /**
  * --------------------------------------------------------------------------------
  *  WiFiManagerParameter
@@ -64,7 +213,7 @@ void WiFiManagerParameter::init(const char *id, const char *label, const char *d
 }
 
 WiFiManagerParameter::~WiFiManagerParameter() {
-  if (_value != NULL) {
+  if (_value != NULL && !_pool) {
     delete[] _value;
   }
   _length=0; // setting length 0, ideally the entire parameter should be removed, or added to wifimanager scope so it follows
@@ -90,9 +239,11 @@ void WiFiManagerParameter::setValue(const char *defaultValue, int length) {
 
   if(_length != length || _value == nullptr){
     _length = length;
-    if( _value != nullptr){
+    utoa(_length, _lengthText, 10); // render metadata
+    if( _value != nullptr && !_pool){
       delete[] _value;
     }
+    _pool.reset(); // length changed, leaves value pool
     _value  = new char[_length + 1];  
   }
 
@@ -101,6 +252,7 @@ void WiFiManagerParameter::setValue(const char *defaultValue, int length) {
   if (defaultValue != NULL) {
     strncpy(_value, defaultValue, _length);
   }
+  parse();
 }
 const char* WiFiManagerParameter::getValue() const {
   // Serial.println(printf("Address of _value is %p\n", (void *)_value)); 
@@ -124,6 +276,162 @@ int WiFiManagerParameter::getLabelPlacement() const {
 const char* WiFiManagerParameter::getCustomHTML() const {
   return _customHTML;
 }
+const char* WiFiManagerParameter::getGroup() const {
+  return _group;
+}
+void WiFiManagerParameter::setGroup(const char *group) {
+  _group = group;
+}
+bool WiFiManagerParameter::isChanged() const {
+  return _changed;
+}
+void WiFiManagerParameter::setChangeCallback(std::function<void(WiFiManagerParameter*, const char*)> func) {
+  _changecallback = func;
+}
+PGM_P WiFiManagerParameter::getFormTemplate() const {
+  return HTTP_FORM_PARAM;
+}
+const char* WiFiManagerParameter::getFormValue() const {
+  return getValue();
+}
+bool WiFiManagerParameter::validate(const char *value) const {
+  return true;
+}
+void WiFiManagerParameter::parse() {
+}
+
+/**
+ * --------------------------------------------------------------------------------
+ *  Typed parameters
+ * --------------------------------------------------------------------------------
+**/
+
+WiFiManagerParameterInt::WiFiManagerParameterInt(const char *id, const char *label, long value, long min, long max)
+  : WiFiManagerParameter(id, label, "", 11) { // -2147483648
+  _min  = min;
+  _max  = max;
+  _attr = F("type='number' step='1'");
+  if(min != LONG_MIN) _attr += (String)F(" min='") + String(min) + "'";
+  if(max != LONG_MAX) _attr += (String)F(" max='") + String(max) + "'";
+  setInt(value);
+}
+long WiFiManagerParameterInt::getInt() const {
+  return _int;
+}
+void WiFiManagerParameterInt::setInt(long value) {
+  setValue(String(value).c_str(), _length);
+}
+const char* WiFiManagerParameterInt::getCustomHTML() const {
+  return _attr.c_str();
+}
+bool WiFiManagerParameterInt::validate(const char *value) const {
+  char *end;
+  long v = strtol(value, &end, 10);
+  return end != value && *end == '\0' && v >= _min && v <= _max;
+}
+void WiFiManagerParameterInt::parse() {
+  _int = strtol(_value, NULL, 10);
+}
+
+WiFiManagerParameterFloat::WiFiManagerParameterFloat(const char *id, const char *label, float value, float min, float max, uint8_t decimals)
+  : WiFiManagerParameter(id, label, "", 16) {
+  _min      = min;
+  _max      = max;
+  _decimals = decimals;
+  _attr     = F("type='number' step='any'");
+  if(min != -FLT_MAX) _attr += (String)F(" min='") + WM_floatOut(min) + "'";
+  if(max != FLT_MAX)  _attr += (String)F(" max='") + WM_floatOut(max) + "'";
+  setFloat(value);
+}
+float WiFiManagerParameterFloat::getFloat() const {
+  return _float;
+}
+void WiFiManagerParameterFloat::setFloat(float value) {
+  setValue(String(value, _decimals).c_str(), _length);
+}
+const char* WiFiManagerParameterFloat::getCustomHTML() const {
+  return _attr.c_str();
+}
+bool WiFiManagerParameterFloat::validate(const char *value) const {
+  char *end;
+  float v = strtof(value, &end);
+  return end != value && *end == '\0' && v >= _min && v <= _max;
+}
+void WiFiManagerParameterFloat::parse() {
+  _float = strtof(_value, NULL);
+}
+
+WiFiManagerParameterBool::WiFiManagerParameterBool(const char *id, const char *label, bool value)
+  : WiFiManagerParameter(id, label, "", 1) {
+  setBool(value);
+}
+bool WiFiManagerParameterBool::getBool() const {
+  return _bool;
+}
+void WiFiManagerParameterBool::setBool(bool value) {
+  setValue(value ? "1" : "0", _length);
+}
+const char* WiFiManagerParameterBool::getCustomHTML() const {
+  return _bool ? "type='checkbox' checked" : "type='checkbox'";
+}
+// checkbox posts its value only when checked, unchecked saves empty
+const char* WiFiManagerParameterBool::getFormValue() const {
+  return "1";
+}
+void WiFiManagerParameterBool::parse() {
+  _bool = _value[0] != '\0' && _value[0] != '0';
+}
+
+WiFiManagerParameterEnum::WiFiManagerParameterEnum(const char *id, const char *label, const char * const *options, uint8_t count, uint8_t selected)
+  : WiFiManagerParameter(id, label, "", 0) {
+  _options = options;
+  _count   = count;
+  int length = 0;
+  for(uint8_t i = 0; i < count; i++){
+    if((int)strlen(options[i]) > length) length = strlen(options[i]);
+  }
+  setValue("", length);
+  setIndex(selected);
+}
+uint8_t WiFiManagerParameterEnum::getIndex() const {
+  return _index;
+}
+void WiFiManagerParameterEnum::setIndex(uint8_t index) {
+  if(index >= _count) return;
+  setValue(_options[index], _length);
+}
+// option list, rendered in HTTP_FORM_SELECT
+const char* WiFiManagerParameterEnum::getCustomHTML() const {
+  return _optionsHTML.c_str();
+}
+PGM_P WiFiManagerParameterEnum::getFormTemplate() const {
+  return HTTP_FORM_SELECT;
+}
+int WiFiManagerParameterEnum::find(const char *value) const {
+  for(uint8_t i = 0; i < _count; i++){
+    if(strcmp(value, _options[i]) == 0) return i;
+  }
+  return -1;
+}
+bool WiFiManagerParameterEnum::validate(const char *value) const {
+  return find(value) >= 0;
+}
+void WiFiManagerParameterEnum::parse() {
+  int i = find(_value);
+  _index = i < 0 ? 0 : i;
+
+  // option list with the selected option marked
+  _optionsHTML = "";
+  for(uint8_t o = 0; o < _count; o++){
+    String option;
+    WM_htmlOut(option, _options[o]);
+    _optionsHTML += F("<option value='");
+    _optionsHTML += option;
+    _optionsHTML += o == _index ? F("' selected>") : F("'>");
+    _optionsHTML += option;
+    _optionsHTML += F("</option>");
+  }
+}
 
 /**
  * [addParameter description]
@@ -134,49 +442,37 @@ bool WiFiManager::addParameter(WiFiManagerParameter *p) {
 
   // check param id is valid, unless null
   if(p->getID()){
-    for (size_t i = 0; i < strlen(p->getID()); i++){
-       if(!(isAlphaNumeric(p->getID()[i])) && !(p->getID()[i]=='_')){
+    for (const char *c = p->getID(); *c; c++){
+       if(!(isAlphaNumeric(*c)) && !(*c=='_')){
         #ifdef WM_DEBUG_LEVEL
         DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] parameter IDs can only contain alpha numeric chars"));
         #endif
         return false;
        }
     }
-  }
-
-  // init params if never malloc
-  if(_params == NULL){
-    #ifdef WM_DEBUG_LEVEL
-    DEBUG_WM(WM_DEBUG_DEV,F("allocating params bytes:"),_max_params * sizeof(WiFiManagerParameter*));        
-    #endif
-    _params = (WiFiManagerParameter**)malloc(_max_params * sizeof(WiFiManagerParameter*));
-  }
-
-  // resize the params array by increment of WIFI_MANAGER_MAX_PARAMS
-  if(_paramsCount == _max_params){
-    _max_params += WIFI_MANAGER_MAX_PARAMS;
-    #ifdef WM_DEBUG_LEVEL
-    DEBUG_WM(WM_DEBUG_DEV,F("Updated _max_params:"),_max_params);
-    DEBUG_WM(WM_DEBUG_DEV,F("re-allocating params bytes:"),_max_params * sizeof(WiFiManagerParameter*));    
-    #endif
-    WiFiManagerParameter** new_params = (WiFiManagerParameter**)realloc(_params, _max_params * sizeof(WiFiManagerParameter*));
-    #ifdef WM_DEBUG_LEVEL
-    // DEBUG_WM(WIFI_MANAGER_MAX_PARAMS);
-    // DEBUG_WM(_paramsCount);
-    // DEBUG_WM(_max_params);
-    #endif
-    if (new_params != NULL) {
-      _params = new_params;
-    } else {
+    if(getParameter(p->getID())){
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] parameter ID already added:"),p->getID());
+      #endif
+      return false;
+    }
+    if(strcmp_P(p->getID(), S_paramgroup) == 0){
       #ifdef WM_DEBUG_LEVEL
-      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] failed to realloc params, size not increased!"));
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] parameter ID is reserved:"),p->getID());
       #endif
       return false;
     }
   }
 
+  // grow params array geometrically, from WIFI_MANAGER_MAX_PARAMS
+  if(_params == NULL || _paramsCount >= _max_params){
+    int count = _params == NULL ? _max_params : _max_params * 2;
+    if(!reserveParameters(count < 1 ? 1 : count)) return false;
+  }
+
   _params[_paramsCount] = p;
   _paramsCount++;
+  if(p->getID()) indexParameter(_paramsCount - 1);
   
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("Added Parameter:"),p->getID());
@@ -184,6 +480,139 @@ bool WiFiManager::addParameter(WiFiManagerParameter *p) {
   return true;
 }
 
+/**
+ * reserveParameters
+ * allocate params array for count params at once, avoids regrowing while adding many
+ * @since $dev
+ * @param  int count
+ * @return bool false if count < 1 or allocation failed, params unchanged
+ */
+bool WiFiManager::reserveParameters(int count){
+  if(count < 1) return false;
+  if(_params != NULL && count <= _max_params) return true;
+  if(count < _paramsCount) count = _paramsCount;
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("allocating params bytes:"),count * sizeof(WiFiManagerParameter*));
+  #endif
+  WiFiManagerParameter** new_params = (WiFiManagerParameter**)realloc(_params, count * sizeof(WiFiManagerParameter*));
+  if (new_params == NULL) {
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] failed to realloc params, size not increased!"));
+    #endif
+    return false;
+  }
+  _params     = new_params;
+  _max_params = count;
+
+  // id index, at most half full
+  uint16_t size = 16;
+  while(size < _max_params * 2) size <<= 1;
+  if(size > _paramSlotsSize){
+    uint16_t *slots = (uint16_t*)realloc(_paramSlots, size * sizeof(uint16_t));
+    if(slots == NULL) return true; // array grown, lookups fall back to a scan
+    _paramSlots     = slots;
+    _paramSlotsSize = size;
+    memset(_paramSlots, 0, size * sizeof(uint16_t));
+    for (int i = 0; i < _paramsCount; i++) {
+      if(_params[i]->getID()) indexParameter(i);
+    }
+  }
+  return true;
+}
+
+void WiFiManager::indexParameter(int i){
+  if(_paramSlotsSize == 0 || _paramsCount * 2 > _paramSlotsSize) return;
+  uint16_t mask = _paramSlotsSize - 1;
+  uint16_t slot = WM_hash(_params[i]->getID()) & mask;
+  while(_paramSlots[slot]) slot = (slot + 1) & mask;
+  _paramSlots[slot] = i + 1;
+}
+
+/**
+ * getParameter
+ * @since $dev
+ * @param  const char id
+ * @return WiFiManagerParameter* added parameter with id, NULL if none
+ */
+WiFiManagerParameter* WiFiManager::getParameter(const char *id) {
+  if(id == NULL || _params == NULL) return NULL;
+  if(_paramSlotsSize == 0 || _paramsCount * 2 > _paramSlotsSize){
+    for (int i = 0; i < _paramsCount; i++) {
+      if(_params[i]->getID() && strcmp(_params[i]->getID(), id) == 0) return _params[i];
+    }
+    return NULL;
+  }
+  uint16_t mask = _paramSlotsSize - 1;
+  uint16_t slot = WM_hash(id) & mask;
+  while(_paramSlots[slot]){
+    WiFiManagerParameter *p = _params[_paramSlots[slot] - 1];
+    if(strcmp(p->getID(), id) == 0) return p;
+    slot = (slot + 1) & mask;
+  }
+  return NULL;
+}
+
+/**
+ * packParameters
+ * compaction pass, move all parameter value buffers into one block, shared by the parameters
+ * so it outlives WiFiManager if they do, getValue() still returns the buffer directly
+ * values are first allocated per parameter, so the block lands after them and their freed
+ * buffers are left as holes below it, this saves per block overhead, it does not undo
+ * fragmentation already made, pack right after adding parameters for the most benefit
+ * a parameter whose length changes with setValue() leaves the pool, the next call repacks
+ * called on portal start if setParamPool(true)
+ * @since $dev
+ * @return bool false if the pool could not be allocated, values stay where they were
+ */
+bool WiFiManager::packParameters(){
+  size_t bytes = 0;
+  bool packed  = true; // all values already share one pool
+  std::shared_ptr<char> *first = nullptr;
+  for (int i = 0; i < _paramsCount; i++) {
+    WiFiManagerParameter *p = _params[i];
+    if(!p || !p->_id || !p->_value) continue;
+    bytes += p->_length + 1;
+    if(!first) first = &p->_pool;
+    if(!p->_pool || p->_pool != *first) packed = false;
+  }
+  if(bytes == 0 || packed) return true;
+
+  std::shared_ptr<char> pool(new (std::nothrow) char[bytes], std::default_delete<char[]>());
+  if(!pool){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] failed to alloc param pool bytes:"),bytes);
+    #endif
+    return false;
+  }
+
+  char *next = pool.get();
+  for (int i = 0; i < _paramsCount; i++) {
+    WiFiManagerParameter *p = _params[i];
+    if(!p || !p->_id || !p->_value) continue;
+    memcpy(next, p->_value, p->_length + 1);
+    if(!p->_pool) delete[] p->_value;
+    p->_value = next;
+    p->_pool  = pool; // old pool freed with its last parameter
+    next += p->_length + 1;
+  }
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("packed param values bytes:"),bytes);
+  #endif
+  return true;
+}
+
+/**
+ * setParamPool
+ * pack parameter values into one pooled block on portal start, see packParameters
+ * @since $dev
+ * @param bool enable default false
+ */
+void WiFiManager::setParamPool(bool enable){
+  _paramPool = enable;
+}
+
 /**
  * [getParameters description]
  * @access public
@@ -200,6 +629,127 @@ int WiFiManager::getParametersCount() {
   return _paramsCount;
 }
 
+#ifdef WM_DNSRESPONDER
+/**
+ * --------------------------------------------------------------------------------
+ *  WiFiManagerDNS
+ * --------------------------------------------------------------------------------
+**/
+
+WiFiManagerDNS::WiFiManagerDNS(){
+  buildAnswer();
+}
+
+WiFiManagerDNS::~WiFiManagerDNS(){
+  stop();
+}
+
+bool WiFiManagerDNS::start(const uint16_t port, const IPAddress &resolvedIP){
+  _resolvedIP = (uint32_t)resolvedIP;
+  _served     = 0;
+  _dropped    = 0;
+  buildAnswer();
+  return _udp.begin(port) == 1;
+}
+
+void WiFiManagerDNS::stop(){
+  _udp.stop();
+}
+
+void WiFiManagerDNS::setTTL(const uint32_t ttl){
+  _ttl = ttl;
+  buildAnswer();
+}
+
+uint32_t WiFiManagerDNS::getQueriesServed(){
+  return _served;
+}
+
+uint32_t WiFiManagerDNS::getQueriesDropped(){
+  return _dropped;
+}
+
+// answer record, appended as is to every A response
+void WiFiManagerDNS::buildAnswer(){
+  IPAddress ip(_resolvedIP);
+  _answer[0]  = 0xC0; // name, pointer to question at offset 12
+  _answer[1]  = 0x0C;
+  _answer[2]  = 0x00; // type A
+  _answer[3]  = 0x01;
+  _answer[4]  = 0x00; // class IN
+  _answer[5]  = 0x01;
+  _answer[6]  = (_ttl >> 24) & 0xFF;
+  _answer[7]  = (_ttl >> 16) & 0xFF;
+  _answer[8]  = (_ttl >> 8) & 0xFF;
+  _answer[9]  = _ttl & 0xFF;
+  _answer[10] = 0x00; // rdlength 4
+  _answer[11] = 0x04;
+  _answer[12] = ip[0];
+  _answer[13] = ip[1];
+  _answer[14] = ip[2];
+  _answer[15] = ip[3];
+}
+
+/**
+ * answer pending queries
+ * the query is rewritten in place to a response, question kept, any additional records (edns) cut
+ * malformed, non query, multi question or oversized packets are dropped
+ */
+void WiFiManagerDNS::processNextRequest(){
+  const uint8_t hlen = 12; // dns header
+  int len;
+  for(uint8_t n = 0; n < WM_DNS_BATCH && (len = _udp.parsePacket()) > 0; n++){
+    if(len > (int)(sizeof(_buffer) - sizeof(_answer)) || len < hlen + 5){
+      _dropped++; // remainder is discarded by next parsePacket
+      continue;
+    }
+    _udp.read(_buffer, len);
+
+    // QR must be query, opcode standard query, one question
+    if((_buffer[2] & 0xF8) != 0 || _buffer[4] != 0 || _buffer[5] != 1){
+      _dropped++;
+      continue;
+    }
+
+    // skip qname labels
+    int pos = hlen;
+    while(pos < len && _buffer[pos] != 0){
+      if(_buffer[pos] & 0xC0) { pos = len; break; } // no compression in questions
+      pos += _buffer[pos] + 1;
+    }
+    pos++; // root label
+    if(pos + 4 > len){
+      _dropped++;
+      continue;
+    }
+    uint16_t qtype  = (_buffer[pos] << 8) | _buffer[pos+1];
+    uint16_t qclass = (_buffer[pos+2] << 8) | _buffer[pos+3];
+    pos += 4;
+
+    _buffer[2]  = 0x84 | (_buffer[2] & 0x01); // response, authoritative, keep RD
+    _buffer[3]  = 0x80; // RA, NOERROR
+    _buffer[6]  = 0;    // ancount
+    _buffer[7]  = 0;
+    _buffer[8]  = 0;    // nscount
+    _buffer[9]  = 0;
+    _buffer[10] = 0;    // arcount
+    _buffer[11] = 0;
+
+    // A or ANY gets the portal ip, AAAA(28) HTTPS(65) and the rest get an empty answer
+    if((qtype == 1 || qtype == 255) && qclass == 1){
+      _buffer[7] = 1;
+      memcpy(_buffer + pos, _answer, sizeof(_answer));
+      pos += sizeof(_answer);
+    }
+
+    _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+    _udp.write(_buffer, pos);
+    _udp.endPacket();
+    _served++;
+  }
+}
+#endif
+
 /**
  * --------------------------------------------------------------------------------
  *  WiFiManager 
@@ -233,6 +783,9 @@ WiFiManager::~WiFiManager() {
     free(_params);
     _params = NULL;
   }
+  free(_paramSlots);
+  free(_argSlots);
+  free(_argParams);
 
   // remove event
   // WiFi.onEvent(std::bind(&WiFiManager::WiFiEvent,this,_1,_2));
@@ -279,22 +832,30 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(F("AutoConnect"));
   #endif
+  #ifdef WM_TRACE
+  traceReset();
+  #endif
+  WM_TRACE_START(tr_total,"autoConnect");
 
   // bool wifiIsSaved = getWiFiIsSaved();
   bool wifiIsSaved = true; // workaround until I can check esp32 wifiisinit and has nvs
 
   #ifdef ESP32
+  WM_TRACE_START(tr_host,"setupHostname");
   setupHostname(true);
+  WM_TRACE_END(tr_host);
 
   if(_hostname != ""){
     // disable wifi if already on
     if(WiFi.getMode() & WIFI_STA){
+      WM_TRACE_START(tr_off,"mode WIFI_OFF");
       WiFi.mode(WIFI_OFF);
       int timeout = millis()+1200;
       // async loop for mode change
       while(WiFi.getMode()!= WIFI_OFF && millis()<timeout){
         delay(0);
       }
+      WM_TRACE_END(tr_off);
     }
   }
   #endif
@@ -306,15 +867,21 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
     _begin();
 
     // attempt to connect using saved settings, on fail fallback to AP config portal
+    WM_TRACE_START(tr_sta,"enableSTA");
     if(!WiFi.enableSTA(true)){
       // handle failure mode Brownout detector etc.
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_ERROR,F("[FATAL] Unable to enable wifi!"));
       #endif
+      WM_TRACE_END(tr_sta);
+      WM_TRACE_END(tr_total);
       return false;
     }
+    WM_TRACE_END(tr_sta);
     
+    WM_TRACE_START(tr_country,"WiFiSetCountry");
     WiFiSetCountry();
+    WM_TRACE_END(tr_country);
 
     #ifdef ESP32
     if(esp32persistent) WiFi.persistent(false); // disable persistent for esp32 after esp_wifi_start or else saves wont work
@@ -329,7 +896,9 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
 
     #ifdef ESP8266
     if(_hostname != ""){
+      WM_TRACE_START(tr_host,"setupHostname");
       setupHostname(true);
+      WM_TRACE_END(tr_host);
     }
     #endif
 
@@ -347,7 +916,11 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
       // and we have no idea WHAT we are connected to
     }
 
-    if(connected || connectWifi(_defaultssid, _defaultpass) == WL_CONNECTED){
+    WM_TRACE_START(tr_conx,"connectWifi");
+    if(!connected) connected = connectWifi(_defaultssid, _defaultpass) == WL_CONNECTED;
+    WM_TRACE_END(tr_conx);
+
+    if(connected){
       //connected
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(F("AutoConnect: SUCCESS"));
@@ -362,6 +935,7 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
           DEBUG_WM(WM_DEBUG_DEV,F("hostname: STA: "),getWiFiHostname());
         #endif
       }
+      WM_TRACE_END(tr_total);
       return true; // connected success
     }
 
@@ -375,6 +949,8 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
     #endif
   }
 
+  WM_TRACE_END(tr_total);
+
   // possibly skip the config portal
   if (!_enableConfigPortal) {
     #ifdef WM_DEBUG_LEVEL
@@ -389,6 +965,77 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
   return res;
 }
 
+/**
+ * autoConnectFast
+ * minimal connect for deep sleep wake cycles, skips mode toggling, hostname, country and retries
+ * issues a single begin with saved credentials and the cached channel and bssid,
+ * static ip is applied if set so dhcp is skipped as well
+ * cache WiFi.channel() and WiFi.BSSID() after a successful connect (eg. rtc memory) and pass them in on the next wake
+ * on failure or deadline falls back to the normal autoConnect flow
+ * @since $dev
+ * @access public
+ * @param  int32_t     channel    cached ap channel, 0 for unknown
+ * @param  uint8_t     *bssid     cached ap bssid (6 bytes), NULL for unknown
+ * @param  char const  *apName     configportal ap name for fallback, NULL for default
+ * @param  char const  *apPassword configportal ap password for fallback
+ * @return bool connected
+ */
+boolean WiFiManager::autoConnectFast(int32_t channel, const uint8_t *bssid, char const *apName, char const *apPassword){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("AutoConnect Fast"));
+  #endif
+  #ifdef WM_TRACE
+  traceReset();
+  #endif
+  WM_TRACE_START(tr_fast,"autoConnectFast");
+
+  _startconn = millis();
+  _begin();
+
+  #ifdef ESP32
+  WiFi.enableSTA(true); // stored config cannot be read until wifi is init
+  #endif
+
+  String ssid = WiFi_SSID(true);
+  uint8_t status = WL_IDLE_STATUS;
+
+  if(ssid != ""){
+    _usermode = WIFI_STA;
+    if(_sta_static_ip) setSTAConfig();
+    WiFi.begin(ssid.c_str(), WiFi_psk(true).c_str(), channel > 0 ? channel : 0, bssid, true);
+
+    unsigned long timeoutmillis = millis() + _fastConnectTimeout;
+    while(millis() < timeoutmillis){
+      status = WiFi.status();
+      if(status == WL_CONNECTED || status == WL_CONNECT_FAILED) break;
+      delay(10);
+    }
+  }
+  #ifdef WM_DEBUG_LEVEL
+  else DEBUG_WM(F("No Credentials are Saved, skipping fast connect"));
+  #endif
+
+  WM_TRACE_END(tr_fast);
+
+  if(status == WL_CONNECTED){
+    _lastconxresult = WL_CONNECTED;
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(F("AutoConnect Fast: SUCCESS"));
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Connected in"),(String)((millis()-_startconn)) + " ms");
+    DEBUG_WM(F("STA IP Address:"),WiFi.localIP());
+    #endif
+    return true;
+  }
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("AutoConnect Fast: FAILED for "),(String)((millis()-_startconn)) + " ms, falling back");
+  #endif
+  WiFi_Disconnect(); // drop the pinned bssid attempt before the full connect
+
+  if(apName == NULL) return autoConnect();
+  return autoConnect(apName, apPassword);
+}
+
 bool WiFiManager::setupHostname(bool restart){
   if(_hostname == "") {
     #ifdef WM_DEBUG_LEVEL
@@ -627,7 +1274,18 @@ void WiFiManager::setupHTTPServer(){
     #endif
   }
 
+  // warm restart, server and handlers kept from last portal, just listen again
+  if(_warmRestart && server && _serverPort == _httpPort){
+    server->begin();
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("HTTP server restarted"));
+    #endif
+    return;
+  }
+
+  if(server) server->stop(); // kept by warm restart, port changed
   server.reset(new WM_WebServer(_httpPort));
+  _serverPort = _httpPort;
   // This is not the safest way to reset the webserver, it can cause crashes on callbacks initilized before this and since its a shared pointer...
 
   if ( _webservercallback != NULL) {
@@ -640,22 +1298,15 @@ void WiFiManager::setupHTTPServer(){
   
   /* Setup httpd callbacks, web pages: root, wifi config pages, SO captive portal detectors and not found. */
 
-  // G macro workaround for Uri() bug https://github.com/esp8266/Arduino/issues/7102
-  server->on(WM_G(R_root),       std::bind(&WiFiManager::handleRoot, this));
-  server->on(WM_G(R_wifi),       std::bind(&WiFiManager::handleWifi, this, true));
-  server->on(WM_G(R_wifinoscan), std::bind(&WiFiManager::handleWifi, this, false));
-  server->on(WM_G(R_wifisave),   std::bind(&WiFiManager::handleWifiSave, this));
-  server->on(WM_G(R_info),       std::bind(&WiFiManager::handleInfo, this));
-  server->on(WM_G(R_param),      std::bind(&WiFiManager::handleParam, this));
-  server->on(WM_G(R_paramsave),  std::bind(&WiFiManager::handleParamSave, this));
-  server->on(WM_G(R_restart),    std::bind(&WiFiManager::handleReset, this));
-  server->on(WM_G(R_exit),       std::bind(&WiFiManager::handleExit, this));
-  server->on(WM_G(R_close),      std::bind(&WiFiManager::handleClose, this));
-  server->on(WM_G(R_erase),      std::bind(&WiFiManager::handleErase, this, false));
-  server->on(WM_G(R_status),     std::bind(&WiFiManager::handleWiFiStatus, this));
+  // portal pages are not registered per route, they are dispatched from WM_DISPATCH by dispatchRoute() in the not found handler
+  // routes added in _webservercallback are matched by the server first
   server->onNotFound (std::bind(&WiFiManager::handleNotFound, this));
-  
-  server->on(WM_G(R_update), std::bind(&WiFiManager::handleUpdate, this));
+
+  #ifdef WM_STREAMFORM
+  server->addHandler(new WiFiManagerFormHandler(this)); // owned by server
+  #endif
+
+  // G macro workaround for Uri() bug https://github.com/esp8266/Arduino/issues/7102
   server->on(WM_G(R_updatedone), HTTP_POST, std::bind(&WiFiManager::handleUpdateDone, this), std::bind(&WiFiManager::handleUpdating, this));
   
   server->begin(); // Web server start
@@ -665,18 +1316,28 @@ void WiFiManager::setupHTTPServer(){
 }
 
 void WiFiManager::setupDNSD(){
-  dnsServer.reset(new DNSServer());
+  if(!_warmRestart || !dnsServer) dnsServer.reset(new WM_DNSServer());
 
   /* Setup the DNS server redirecting all the domains to the apIP */
+  #ifndef WM_DNSRESPONDER
   dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
+  #endif
   #ifdef WM_DEBUG_LEVEL
   // DEBUG_WM("dns server started port: ",DNS_PORT);
   DEBUG_WM(WM_DEBUG_DEV,F("dns server started with ip: "),WiFi.softAPIP()); // @todo not showing ip
   #endif
+  #ifdef WM_DNSRESPONDER
+  dnsServer->start(DNS_PORT, WiFi.softAPIP());
+  #else
   dnsServer->start(DNS_PORT, F("*"), WiFi.softAPIP());
+  #endif
 }
 
 void WiFiManager::setupConfigPortal() {
+  #ifdef WM_METRICS
+  _metrics.portalStart = millis();
+  #endif
+  if(_paramPool) packParameters();
   setupHTTPServer();
   _lastscan = 0; // reset network scan cache
   if(_preloadwifiscan) WiFi_scanNetworks(true,true); // preload wifiscan , async
@@ -863,21 +1524,57 @@ boolean WiFiManager::process(){
  * @return {[type]} [description]
  */
 uint8_t WiFiManager::processConfigPortal(){
-    if(configPortalActive){
-      //DNS handler
-      dnsServer->processNextRequest();
+    // alternate dns and http passes while either did work, until the loop budget is spent
+    // keeps joining clients from queueing behind each other, one pass if budget is 0
+    unsigned long loopStart = millis();
+    bool work;
+    do {
+      uint32_t served = _httpServed;
+      #ifdef WM_DNSRESPONDER
+      uint32_t queries = configPortalActive ? dnsServer->getQueriesServed() + dnsServer->getQueriesDropped() : 0;
+      #endif
+
+      if(configPortalActive){
+        //DNS handler
+        dnsServer->processNextRequest();
+      }
+
+      //HTTP handler
+      server->handleClient();
+
+      work = _httpServed != served;
+      #ifdef WM_DNSRESPONDER
+      if(configPortalActive) work |= (dnsServer->getQueriesServed() + dnsServer->getQueriesDropped()) != queries;
+      #endif
+      if(connect || abort) break; // save or exit pending, handle now
+      if(work) yield(); // watchdog
+    } while(work && (millis() - loopStart < _portalLoopBudget));
+
+    #ifdef WM_HTTPKEEPALIVE
+    // close kept alive connection once idle
+    if(_httpConnRequests && (millis() - _httpLastRequest > _httpIdleTimeout)){
+      if(server->client().connected() && (uint32_t)server->client().remoteIP() == _httpConnIP && server->client().remotePort() == _httpConnPort){
+        server->client().stop();
+      }
+      _httpConnRequests = 0;
     }
+    #endif
 
-    //HTTP handler
-    server->handleClient();
+    // handler actions (exit, reboot) run here so handlers never block the loop
+    processDeferred();
 
     // Waiting for save...
     if(connect) {
+      // keeps the captiveportal from closing to fast, dns and http keep being served meanwhile
+      if(_enableCaptivePortal && _cpclosedelay > 0){
+        if(_connectDelayStart == 0) _connectDelayStart = millis();
+        if(millis() - _connectDelayStart < (unsigned long)_cpclosedelay) return WL_IDLE_STATUS;
+      }
+      _connectDelayStart = 0;
       connect = false;
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_VERBOSE,F("processing save"));
       #endif
-      if(_enableCaptivePortal) delay(_cpclosedelay); // keeps the captiveportal from closing to fast.
 
       // skip wifi if no ssid
       if(_ssid == ""){
@@ -887,6 +1584,9 @@ uint8_t WiFiManager::processConfigPortal(){
       }
       else{
         // attempt sta connection to submitted _ssid, _pass
+        #ifdef WM_TRACE
+        traceReset(); // new timeline, not appended to autoconnect
+        #endif
         uint8_t res = connectWifi(_ssid, _pass, _connectonsave) == WL_CONNECTED;
         if (res || (!_connectonsave)) {
           #ifdef WM_DEBUG_LEVEL
@@ -961,6 +1661,10 @@ bool WiFiManager::shutdownConfigPortal(){
 
   if(webPortalActive) return false;
 
+  // drop pending exit/reboot and close delay, they belong to this portal
+  _deferAction       = WM_DEFER_NONE;
+  _connectDelayStart = 0;
+
   if(configPortalActive){
     //DNS handler
     dnsServer->processNextRequest();
@@ -972,14 +1676,23 @@ bool WiFiManager::shutdownConfigPortal(){
   // @todo what is the proper way to shutdown and free the server up
   // debug - many open issues aobut port not clearing for use with other servers
   server->stop();
-  server.reset();
+  if(!_warmRestart){
+    server.reset();
+    _page = String(); // release page buffer
+    _pageReserved = false;
+  }
 
   WiFi.scanDelete(); // free wifi scan results
 
   if(!configPortalActive) return false;
 
+  #if defined(WM_DNSRESPONDER) && defined(WM_DEBUG_LEVEL)
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("dns queries served:"),dnsServer->getQueriesServed());
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("dns queries dropped:"),dnsServer->getQueriesDropped());
+  #endif
+
   dnsServer->stop(); //  free heap ?
-  dnsServer.reset();
+  if(!_warmRestart) dnsServer.reset();
 
   // turn off AP
   // @todo bug workaround
@@ -1022,7 +1735,10 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
   uint8_t retry = 1;
   uint8_t connRes = (uint8_t)WL_NO_SSID_AVAIL;
 
+  WM_HEAP_SAMPLE(WM_ROUTE_CONNECT);
+  WM_TRACE_START(tr_staconf,"setSTAConfig");
   setSTAConfig();
+  WM_TRACE_END(tr_staconf);
   //@todo catch failures in set_config
   
   // make sure sta is on before `begin` so it does not call enablesta->mode while persistent is ON ( which would save WM AP state to eeprom !)
@@ -1035,6 +1751,7 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
   // [E][WiFiSTA.cpp:221] begin(): connect failed!
 
   while(retry <= _connectRetries && (connRes!=WL_CONNECTED)){
+  WM_TRACE_START(tr_try,"connect attempt");
   if(_connectRetries > 1){
     if(_aggresiveReconn) delay(1000); // add idle time before recon
     #ifdef WM_DEBUG_LEVEL
@@ -1072,6 +1789,10 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("Connection result:"),getWLStatusString(connRes));
   #endif
+  WM_TRACE_END(tr_try);
+  #ifdef WM_METRICS
+  _metrics.connects[connRes < WM_METRICS_CONX_CODES - 1 ? connRes : WM_METRICS_CONX_CODES - 1]++;
+  #endif
   retry++;
 }
 
@@ -1090,6 +1811,7 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
     updateConxResult(connRes);
   }
 
+  WM_HEAP_SAMPLE(WM_ROUTE_CONNECT);
   return connRes;
 }
 
@@ -1272,8 +1994,16 @@ void WiFiManager::startWPS() {
 }
 #endif
 
-String WiFiManager::getHTTPHead(String title, String classes){
-  String page;
+/**
+ * start a page in the reusable page buffer
+ * the buffer keeps its capacity between requests (reserved once via setPageBufferSize),
+ * so rendering does not leave freed page sized blocks behind, released on portal shutdown
+ * @return String& page buffer, valid until the next getHTTPHead call
+ */
+String& WiFiManager::getHTTPHead(String title, String classes){
+  String &page = _page;
+  if(_pageBufferSize > 0 && !_pageReserved) _pageReserved = page.reserve(_pageBufferSize);
+  page = ""; // keeps capacity
   page += FPSTR(HTTP_HEAD_START);
   page.replace(FPSTR(T_v), title);
   page += FPSTR(HTTP_SCRIPT);
@@ -1308,14 +2038,104 @@ String WiFiManager::getHTTPEnd() {
 }
 
 void WiFiManager::HTTPSend(const String &content){
+  #ifdef WM_LATENCY
+  _routeRendered = micros();
+  #endif
   server->send(200, FPSTR(HTTP_HEAD_CT), content);
+  routeEnd();
 }
 
-/** 
- * HTTPD handler for page requests
+/**
+ * request stats begin hook, route being handled
+ * @param route wm_route_t
  */
-void WiFiManager::handleRequest() {
-  _webPortalAccessed = millis();
+void WiFiManager::routeStart(uint8_t route){
+  _route = route;
+  _httpServed++;
+  _argsIndexed = false; // new request args
+  #ifdef WM_HEAPSTATS
+  heapSample(route); // start of handler
+  #endif
+  #ifdef WM_METRICS
+  if(route < WM_ROUTE_MAX) _metrics.requests[route]++;
+  #endif
+  #if defined(WM_METRICS) || defined(WM_LATENCY)
+  _routeStart = micros();
+  #endif
+  #ifdef WM_LATENCY
+  _routeRendered = 0;
+  _routeScan     = 0;
+  #endif
+}
+
+/**
+ * request stats end hook, after the response is sent
+ */
+void WiFiManager::routeEnd(){
+  if(_route >= WM_ROUTE_MAX) return;
+  #ifdef WM_HEAPSTATS
+  heapSample(_route); // end of handler
+  #endif
+  #ifdef WM_METRICS
+  static const uint16_t bounds[WM_METRICS_LATENCY_BUCKETS - 1] = {5,20,50,100,250,1000};
+  uint32_t ms = (micros() - _routeStart) / 1000;
+  uint8_t b = 0;
+  while(b < WM_METRICS_LATENCY_BUCKETS - 1 && ms > bounds[b]) b++;
+  _metrics.latency[_route][b]++;
+  _metrics.latencySum[_route] += ms;
+  #endif
+  #ifdef WM_LATENCY
+  unsigned long now = micros();
+  wm_latency_t &l = _latency[_latencyHead];
+  l.route  = _route;
+  l.start  = _routeStart;
+  l.total  = now - _routeStart;
+  l.scan   = _routeScan;
+  l.send   = _routeRendered ? now - _routeRendered : 0;
+  l.render = l.total - l.send - (l.scan < l.total - l.send ? l.scan : l.total - l.send);
+  _latencyHead = (_latencyHead + 1) % WM_LATENCY_SIZE;
+  if(_latencyCount < WM_LATENCY_SIZE) _latencyCount++;
+  #endif
+  _route = WM_ROUTE_MAX;
+}
+
+/**
+ * HTTPD keep-alive accounting, call before sending a response
+ * counts requests on the current connection and lets the server keep it open
+ * until _httpMaxRequests, idle connections are closed in processConfigPortal
+ * @return bool true if the connection stays open after this response
+ */
+bool WiFiManager::HTTPKeepAlive(){
+  #ifdef WM_HTTPKEEPALIVE
+  if(!_httpKeepAlive){
+    server->keepAlive(false);
+    return false;
+  }
+  uint32_t ip   = server->client().remoteIP();
+  uint16_t port = server->client().remotePort();
+  if(ip != _httpConnIP || port != _httpConnPort){
+    _httpConnIP       = ip;
+    _httpConnPort     = port;
+    _httpConnRequests = 0;
+  }
+  if(_httpConnRequests < 255) _httpConnRequests++;
+  _httpLastRequest = millis();
+  bool keep = _httpConnRequests < _httpMaxRequests;
+  server->keepAlive(keep);
+  return keep;
+  #else
+  return false;
+  #endif
+}
+
+/** 
+ * HTTPD handler for page requests, called at the start of each handler
+ * @param route wm_route_t of the handler, for stats
+ */
+void WiFiManager::handleRequest(uint8_t route) {
+  _webPortalAccessed = millis();
+  HTTPKeepAlive();
+  routeStart(route);
 
   // TESTING HTTPD AUTH RFC 2617
   // BASIC_AUTH will hold onto creds, hard to "logout", but convienent
@@ -1346,8 +2166,8 @@ void WiFiManager::handleRoot() {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Root"));
   #endif
   if (captivePortal()) return; // If captive portal redirect instead of displaying the page
-  handleRequest();
-  String page = getHTTPHead(_title, FPSTR(C_root)); // @token options @todo replace options with title
+  handleRequest(WM_ROUTE_ROOT);
+  String &page = getHTTPHead(_title, FPSTR(C_root)); // @token options @todo replace options with title
   String str  = FPSTR(HTTP_ROOT_MAIN); // @todo custom title
   str.replace(FPSTR(T_t),_title);
   str.replace(FPSTR(T_v),configPortalActive ? _apName : (getWiFiHostname() + " - " + WiFi.localIP().toString())); // use ip if ap is not active for heading @todo use hostname?
@@ -1371,14 +2191,14 @@ void WiFiManager::handleWifi(boolean scan) {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Wifi"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titlewifi), FPSTR(C_wifi)); // @token titlewifi
+  handleRequest(WM_ROUTE_WIFI);
+  String &page = getHTTPHead(FPSTR(S_titlewifi), FPSTR(C_wifi)); // @token titlewifi
   if (scan) {
     #ifdef WM_DEBUG_LEVEL
     // DEBUG_WM(WM_DEBUG_DEV,"refresh flag:",server->hasArg(F("refresh")));
     #endif
     WiFi_scanNetworks(server->hasArg(F("refresh")),false); //wifiscan, force if arg refresh
-    page += getScanItemOut();
+    getScanItemOut(page);
   }
   String pitem = "";
 
@@ -1405,7 +2225,7 @@ void WiFiManager::handleWifi(boolean scan) {
   page += FPSTR(HTTP_FORM_WIFI_END);
   if(_paramsInWifi && _paramsCount>0){
     page += FPSTR(HTTP_FORM_PARAM_HEAD);
-    page += getParamOut();
+    getParamOut(page);
   }
   page += FPSTR(HTTP_FORM_END);
   page += FPSTR(HTTP_SCAN_LINK);
@@ -1427,16 +2247,32 @@ void WiFiManager::handleParam(){
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Param"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleparam), FPSTR(C_param)); // @token titlewifi
+  handleRequest(WM_ROUTE_PARAM);
+  String &page = getHTTPHead(FPSTR(S_titleparam), FPSTR(C_param)); // @token titlewifi
 
   String pitem = "";
 
+  // grouped params, one page per group, only the requested group is rendered and saved
+  std::vector<const char*> groups = getParamGroups();
+  int group = getParamGroupArg(groups);
+  for(int g = 0; g < (int)groups.size(); g++){
+    pitem = FPSTR(HTTP_PARAM_GROUP);
+    pitem.replace(FPSTR(T_i), String(g));
+    pitem.replace(FPSTR(T_t), groups[g] ? (String)groups[g] : (String)FPSTR(S_titleparam));
+    pitem.replace(FPSTR(T_c), g == group ? F(" disabled") : F(""));
+    page += pitem;
+  }
+
   pitem = FPSTR(HTTP_FORM_START);
   pitem.replace(FPSTR(T_v), F("paramsave"));
   page += pitem;
+  if(group >= 0){
+    pitem = FPSTR(HTTP_FORM_GROUP);
+    pitem.replace(FPSTR(T_i), String(group));
+    page += pitem;
+  }
 
-  page += getParamOut();
+  getParamOut(page, group < 0 ? NULL : groups[group], group >= 0);
   page += FPSTR(HTTP_FORM_END);
   if(_showBack) page += FPSTR(HTTP_BACKBTN);
   reportStatus(page);
@@ -1474,6 +2310,10 @@ String WiFiManager::getMenuOut(){
 void WiFiManager::WiFi_scanComplete(int networksFound){
   _lastscan = millis();
   _numNetworks = networksFound;
+  WM_HEAP_SAMPLE(WM_ROUTE_SCAN);
+  #ifdef WM_METRICS
+  metricsScan(_lastscan - _startscan);
+  #endif
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("WiFi Scan ASYNC completed"), "in "+(String)(_lastscan - _startscan)+" ms");  
   DEBUG_WM(WM_DEBUG_VERBOSE,F("WiFi Scan ASYNC found:"),_numNetworks);
@@ -1512,6 +2352,10 @@ bool WiFiManager::WiFi_scanNetworks(bool force,bool async){
     if(force){
       int8_t res;
       _startscan = millis();
+      #ifdef WM_LATENCY
+      unsigned long scanStart = micros();
+      #endif
+      WM_HEAP_SAMPLE(WM_ROUTE_SCAN);
       if(async && _asyncScan){
         #ifdef ESP8266
           #ifndef WM_NOASYNC // no async available < 2.4.0
@@ -1555,6 +2399,13 @@ bool WiFiManager::WiFi_scanNetworks(bool force,bool async){
       }
       else if(res >=0 ) _numNetworks = res;
       _lastscan = millis();
+      #ifdef WM_LATENCY
+      _routeScan += micros() - scanStart;
+      #endif
+      WM_HEAP_SAMPLE(WM_ROUTE_SCAN);
+      #ifdef WM_METRICS
+      metricsScan(_lastscan - _startscan);
+      #endif
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_VERBOSE,F("WiFi Scan completed"), "in "+(String)(_lastscan - _startscan)+" ms");
       #endif
@@ -1568,9 +2419,7 @@ bool WiFiManager::WiFi_scanNetworks(bool force,bool async){
     return false;
 }
 
-String WiFiManager::WiFiManager::getScanItemOut(){
-    String page;
-
+void WiFiManager::getScanItemOut(String &page){
     if(!_numNetworks) WiFi_scanNetworks(); // scan in case this gets called before any scans
 
     int n = _numNetworks;
@@ -1641,6 +2490,7 @@ String WiFiManager::WiFiManager::getScanItemOut(){
       bool tok_i = HTTP_ITEM_STR.indexOf(FPSTR(T_i)) > 0;
       
       //display networks in page
+      String item; // reused for every ap
       for (int i = 0; i < n; i++) {
         if (indices[i] == -1) continue; // skip dups
 
@@ -1652,7 +2502,7 @@ String WiFiManager::WiFiManager::getScanItemOut(){
         uint8_t enc_type = WiFi.encryptionType(indices[i]);
 
         if (_minimumQuality == -1 || _minimumQuality < rssiperc) {
-          String item = HTTP_ITEM_STR;
+          item = HTTP_ITEM_STR;
           if(WiFi.SSID(indices[i]) == ""){
             // Serial.println(WiFi.BSSIDstr(indices[i]));
             continue; // No idea why I am seeing these, lets just skip them for now
@@ -1684,8 +2534,6 @@ String WiFiManager::WiFiManager::getScanItemOut(){
       }
       page += FPSTR(HTTP_BR);
     }
-
-    return page;
 }
 
 String WiFiManager::getIpForm(String id, String title, String value){
@@ -1727,87 +2575,105 @@ String WiFiManager::getStaticOut(){
   return page;
 }
 
-String WiFiManager::getParamOut(){
-  String page;
-
+/**
+ * render param inputs
+ * @param String     page
+ * @param const char group   group name, NULL for ungrouped
+ * @param bool       grouped only render params of group
+ */
+void WiFiManager::getParamOut(String &page, const char *group, bool grouped){
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_DEV,F("getParamOut"),_paramsCount);
   #endif
 
   if(_paramsCount > 0){
+    char paramId[12]; // S_parampre + index
+    strncpy_P(paramId, S_parampre, sizeof(paramId) - 1);
+    paramId[sizeof(paramId) - 1] = '\0';
+    size_t paramPreLen = strlen(paramId);
 
-    String HTTP_PARAM_temp = FPSTR(HTTP_FORM_LABEL);
-    HTTP_PARAM_temp += FPSTR(HTTP_FORM_PARAM);
-    bool tok_I = HTTP_PARAM_temp.indexOf(FPSTR(T_I)) > 0;
-    bool tok_i = HTTP_PARAM_temp.indexOf(FPSTR(T_i)) > 0;
-    bool tok_n = HTTP_PARAM_temp.indexOf(FPSTR(T_n)) > 0;
-    bool tok_p = HTTP_PARAM_temp.indexOf(FPSTR(T_p)) > 0;
-    bool tok_t = HTTP_PARAM_temp.indexOf(FPSTR(T_t)) > 0;
-    bool tok_l = HTTP_PARAM_temp.indexOf(FPSTR(T_l)) > 0;
-    bool tok_v = HTTP_PARAM_temp.indexOf(FPSTR(T_v)) > 0;
-    bool tok_c = HTTP_PARAM_temp.indexOf(FPSTR(T_c)) > 0;
-
-    char valLength[5];
-
+    // add the extra parameters to the form
     for (int i = 0; i < _paramsCount; i++) {
-      //Serial.println((String)_params[i]->_length);
-      if (_params[i] == NULL || _params[i]->_length > 99999) {
+      WiFiManagerParameter *p = _params[i];
+      if (p == NULL || p->_length > 99999) {
         // try to detect param scope issues, doesnt always catch but works ok
         #ifdef WM_DEBUG_LEVEL
         DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] WiFiManagerParameter is out of scope"));
         #endif
-        return "";
+        return;
       }
-    }
+      if(grouped && !WM_groupEq(p->getGroup(), group)) continue;
 
-    // add the extra parameters to the form
-    for (int i = 0; i < _paramsCount; i++) {
-     // label before or after, @todo this could be done via floats or CSS and eliminated
-     String pitem;
-      switch (_params[i]->getLabelPlacement()) {
+      // if no ID use customhtml for item, else generate from param templates
+      if (p->getID() == NULL) {
+        page += p->getCustomHTML();
+        continue;
+      }
+      utoa(i, paramId + paramPreLen, 10);
+
+      // label before or after, @todo this could be done via floats or CSS and eliminated
+      switch (p->getLabelPlacement()) {
         case WFM_LABEL_BEFORE:
-          pitem = FPSTR(HTTP_FORM_LABEL);
-          pitem += FPSTR(HTTP_FORM_PARAM);
+          getParamItemOut(page, HTTP_FORM_LABEL, p, paramId);
+          getParamItemOut(page, p->getFormTemplate(), p, paramId);
           break;
         case WFM_LABEL_AFTER:
-          pitem = FPSTR(HTTP_FORM_PARAM);
-          pitem += FPSTR(HTTP_FORM_LABEL);
+          getParamItemOut(page, p->getFormTemplate(), p, paramId);
+          getParamItemOut(page, HTTP_FORM_LABEL, p, paramId);
           break;
         default:
           // WFM_NO_LABEL
-          pitem = FPSTR(HTTP_FORM_PARAM);
+          getParamItemOut(page, p->getFormTemplate(), p, paramId);
           break;
       }
+    }
+  }
+}
 
-      // Input templating
-      // "<br/><input id='{i}' name='{n}' maxlength='{l}' value='{v}' {c}>";
-      // if no ID use customhtml for item, else generate from param string
-      if (_params[i]->getID() != NULL) {
-        if(tok_I)pitem.replace(FPSTR(T_I), (String)FPSTR(S_parampre)+(String)i); // T_I id number
-        if(tok_i)pitem.replace(FPSTR(T_i), _params[i]->getID()); // T_i id name
-        if(tok_n)pitem.replace(FPSTR(T_n), _params[i]->getID()); // T_n id name alias
-        if(tok_p)pitem.replace(FPSTR(T_p), FPSTR(T_t)); // T_p replace legacy placeholder token
-        if(tok_t)pitem.replace(FPSTR(T_t), _params[i]->getLabel()); // T_t title/label
-        snprintf(valLength, 5, "%d", _params[i]->getValueLength());
-        if(tok_l)pitem.replace(FPSTR(T_l), valLength); // T_l value length
-        if(tok_v)pitem.replace(FPSTR(T_v), _params[i]->getValue()); // T_v value
-        if(tok_c)pitem.replace(FPSTR(T_c), _params[i]->getCustomHTML()); // T_c meant for additional attributes, not html, but can stuff
-      } else {
-        pitem = _params[i]->getCustomHTML();
+/**
+ * expand a param template into page in one pass, tokens are written directly instead of replace() passes
+ * "<br/><input id='{i}' name='{n}' maxlength='{l}' value='{v}' {c}>"
+ * {I} param_<n>, {i} {n} id, {t} {p} label, {l} value length, {v} value, {c} custom html, others are copied
+ */
+void WiFiManager::getParamItemOut(String &page, PGM_P tpl, WiFiManagerParameter *p, const char *paramId){
+  char run[32]; // literal run buffer, flushed on tokens
+  uint8_t len = 0;
+  char c;
+  while((c = pgm_read_byte(tpl++))){
+    const char *value = NULL;
+    if(c == '{' && pgm_read_byte(tpl + 1) == '}'){
+      switch(pgm_read_byte(tpl)){
+        case 'I': value = paramId; break; // T_I id number
+        case 'i': // T_i id name
+        case 'n': value = p->getID(); break; // T_n id name alias
+        case 't': // T_t title/label
+        case 'p': value = p->getLabel(); break; // T_p legacy placeholder token
+        case 'l': value = p->_lengthText; break; // T_l value length
+        case 'v': value = p->getFormValue(); break; // T_v value
+        case 'c': value = p->getCustomHTML(); break; // T_c meant for additional attributes, not html, but can stuff
       }
-
-      page += pitem;
     }
+    if(value || len == sizeof(run) - 1){
+      run[len] = '\0';
+      page += run;
+      len = 0;
+    }
+    if(value){
+      page += value;
+      tpl += 2;
+      continue;
+    }
+    run[len++] = c;
   }
-
-  return page;
+  run[len] = '\0';
+  page += run;
 }
 
 void WiFiManager::handleWiFiStatus(){
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP WiFi status "));
   #endif
-  handleRequest();
+  handleRequest(WM_ROUTE_STATUS);
   String page;
   // String page = "{\"result\":true,\"count\":1}";
   #ifdef WM_JSTEST
@@ -1816,6 +2682,233 @@ void WiFiManager::handleWiFiStatus(){
   HTTPSend(page);
 }
 
+#ifdef WM_TRACE
+/** 
+ * HTTPD CALLBACK trace, dump autoconnect timeline as text
+ */
+void WiFiManager::handleTrace(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Trace"));
+  #endif
+  handleRequest(); // not sampled, see wm_route_t
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  server->send(200, FPSTR(HTTP_HEAD_CT2), getTraceOut());
+}
+#endif
+
+#ifdef WM_HEAPSTATS
+/** 
+ * HTTPD CALLBACK heap stats, text/plain
+ */
+void WiFiManager::handleHeap(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Heap"));
+  #endif
+  handleRequest(); // not sampled, see wm_route_t
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  server->send(200, FPSTR(HTTP_HEAD_CT2), getHeapStatsOut());
+}
+#endif
+
+#ifdef WM_LATENCY
+/** 
+ * HTTPD CALLBACK latency, request timings as text
+ */
+void WiFiManager::handleLatency(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Latency"));
+  #endif
+  handleRequest(); // not sampled, see wm_route_t
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  server->send(200, FPSTR(HTTP_HEAD_CT2), getLatencyOut());
+}
+
+uint8_t WiFiManager::getLatencyCount(){
+  return _latencyCount;
+}
+
+/**
+ * latency entry
+ * @param  index 0 oldest, getLatencyCount()-1 newest
+ * @return wm_latency_t* or NULL if out of range
+ */
+const wm_latency_t* WiFiManager::getLatency(uint8_t index){
+  if(index >= _latencyCount) return NULL;
+  uint8_t oldest = (_latencyHead + WM_LATENCY_SIZE - _latencyCount) % WM_LATENCY_SIZE;
+  return &_latency[(oldest + index) % WM_LATENCY_SIZE];
+}
+
+/**
+ * latency ring as text, oldest first
+ * route, age ms, scan, render, send, total us, tab separated
+ * @return String
+ */
+String WiFiManager::getLatencyOut(){
+  String out;
+  unsigned long now = micros();
+  for(uint8_t i = 0; i < _latencyCount; i++){
+    const wm_latency_t *l = getLatency(i);
+    out += FPSTR((PGM_P)pgm_read_ptr(&WM_ROUTE_NAMES[l->route]));
+    out += '\t';
+    out += String((now - l->start) / 1000);
+    out += '\t';
+    out += String(l->scan);
+    out += '\t';
+    out += String(l->render);
+    out += '\t';
+    out += String(l->send);
+    out += '\t';
+    out += String(l->total);
+    out += '\n';
+  }
+  return out;
+}
+#endif
+
+#ifdef WM_METRICS
+/** 
+ * HTTPD CALLBACK metrics, prometheus text exposition format
+ * streamed in small chunks, never builds the whole body
+ */
+void WiFiManager::handleMetrics(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Metrics"));
+  #endif
+  handleRequest(); // not sampled, see wm_route_t
+  char   buf[WM_METRICS_CHUNK];
+  size_t len = 0;
+  char   name[24];
+  static const uint16_t latencyBounds[WM_METRICS_LATENCY_BUCKETS - 1] = {5,20,50,100,250,1000};
+  static const uint16_t scanBounds[WM_METRICS_SCAN_BUCKETS - 1]       = {1000,2000,4000,8000};
+
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, FPSTR(HTTP_HEAD_CT_METRICS), "");
+
+  metricsOut(buf, len, PSTR("# TYPE wm_http_requests_total counter\n"));
+  for(uint8_t i = 0; i < WM_ROUTE_MAX; i++){
+    if(!_metrics.requests[i]) continue;
+    strncpy_P(name, (PGM_P)pgm_read_ptr(&WM_ROUTE_NAMES[i]), sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    metricsOut(buf, len, PSTR("wm_http_requests_total{route=\"%s\"} %lu\n"), name, (unsigned long)_metrics.requests[i]);
+  }
+
+  metricsOut(buf, len, PSTR("# TYPE wm_http_request_duration_ms histogram\n"));
+  for(uint8_t i = 0; i < WM_ROUTE_MAX; i++){
+    uint32_t count = 0;
+    for(uint8_t b = 0; b < WM_METRICS_LATENCY_BUCKETS; b++) count += _metrics.latency[i][b];
+    if(!count) continue;
+    strncpy_P(name, (PGM_P)pgm_read_ptr(&WM_ROUTE_NAMES[i]), sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    metricsHistogram(buf, len, PSTR("wm_http_request_duration_ms"), name, latencyBounds, _metrics.latency[i], WM_METRICS_LATENCY_BUCKETS, _metrics.latencySum[i]);
+  }
+
+  metricsOut(buf, len, PSTR("# TYPE wm_captive_redirects_total counter\nwm_captive_redirects_total %lu\n"), (unsigned long)_metrics.captiveRedirects);
+  metricsOut(buf, len, PSTR("# TYPE wm_captive_probes_total counter\nwm_captive_probes_total %lu\n"), (unsigned long)_metrics.captiveProbes);
+
+  #ifdef WM_DNSRESPONDER
+  if(dnsServer){
+    metricsOut(buf, len, PSTR("# TYPE wm_dns_queries_total counter\n"));
+    metricsOut(buf, len, PSTR("wm_dns_queries_total{result=\"served\"} %lu\n"), (unsigned long)dnsServer->getQueriesServed());
+    metricsOut(buf, len, PSTR("wm_dns_queries_total{result=\"dropped\"} %lu\n"), (unsigned long)dnsServer->getQueriesDropped());
+  }
+  #endif
+
+  metricsOut(buf, len, PSTR("# TYPE wm_wifi_scan_duration_ms histogram\n"));
+  metricsHistogram(buf, len, PSTR("wm_wifi_scan_duration_ms"), NULL, scanBounds, _metrics.scan, WM_METRICS_SCAN_BUCKETS, _metrics.scanSum);
+
+  metricsOut(buf, len, PSTR("# TYPE wm_wifi_connect_attempts_total counter\n"));
+  for(uint8_t i = 0; i < WM_METRICS_CONX_CODES; i++){
+    if(!_metrics.connects[i]) continue;
+    metricsOut(buf, len, PSTR("wm_wifi_connect_attempts_total{result=\"%s\"} %lu\n"), i < WM_METRICS_CONX_CODES - 1 ? getWLStatusString(i).c_str() : "other", (unsigned long)_metrics.connects[i]);
+  }
+
+  metricsOut(buf, len, PSTR("# TYPE wm_ota_bytes_total counter\nwm_ota_bytes_total %lu\n"), (unsigned long)_metrics.otaBytes);
+
+  uint32_t free, maxBlock;
+  uint8_t  frag;
+  getHeapStats(free, maxBlock, frag);
+  metricsOut(buf, len, PSTR("# TYPE wm_heap_free_bytes gauge\nwm_heap_free_bytes %lu\n"), (unsigned long)free);
+  metricsOut(buf, len, PSTR("# TYPE wm_heap_max_block_bytes gauge\nwm_heap_max_block_bytes %lu\n"), (unsigned long)maxBlock);
+  metricsOut(buf, len, PSTR("# TYPE wm_heap_fragmentation_percent gauge\nwm_heap_fragmentation_percent %u\n"), frag);
+  #ifdef WM_HEAPSTATS
+  const wm_heap_stats_t *hs = getHeapStatsRoute();
+  metricsOut(buf, len, PSTR("# TYPE wm_heap_min_free_bytes gauge\nwm_heap_min_free_bytes %lu\n"), (unsigned long)hs->minFree);
+  metricsOut(buf, len, PSTR("# TYPE wm_heap_min_max_block_bytes gauge\nwm_heap_min_max_block_bytes %lu\n"), (unsigned long)hs->minMaxBlock);
+  #endif
+
+  metricsOut(buf, len, PSTR("# TYPE wm_portal_uptime_seconds gauge\nwm_portal_uptime_seconds %lu\n"), (unsigned long)((millis() - _metrics.portalStart) / 1000));
+  metricsFlush(buf, len);
+  server->sendContent(""); // end chunked response
+}
+
+/**
+ * format a line into the chunk buffer, flushed to the client when full
+ */
+void WiFiManager::metricsOut(char *buf, size_t &len, PGM_P fmt, ...){
+  char line[128];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf_P(line, sizeof(line), fmt, args);
+  va_end(args);
+  if(n <= 0) return;
+  if((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+  if(len + n > WM_METRICS_CHUNK) metricsFlush(buf, len);
+  memcpy(buf + len, line, n);
+  len += n;
+}
+
+void WiFiManager::metricsFlush(char *buf, size_t &len){
+  if(!len) return;
+  server->sendContent(buf, len);
+  len = 0;
+}
+
+/**
+ * write a histogram, buckets made cumulative, optional route label
+ */
+void WiFiManager::metricsHistogram(char *buf, size_t &len, PGM_P name, PGM_P label, const uint16_t *bounds, const uint32_t *buckets, uint8_t count, uint32_t sum){
+  char metric[32];
+  strncpy_P(metric, name, sizeof(metric) - 1);
+  metric[sizeof(metric) - 1] = '\0';
+  char route[40] = "";
+  if(label) snprintf_P(route, sizeof(route), PSTR("route=\"%s\","), label); // label is in ram
+
+  uint32_t total = 0;
+  for(uint8_t b = 0; b < count; b++){
+    total += buckets[b];
+    if(b < count - 1) metricsOut(buf, len, PSTR("%s_bucket{%sle=\"%u\"} %lu\n"), metric, route, bounds[b], (unsigned long)total);
+    else metricsOut(buf, len, PSTR("%s_bucket{%sle=\"+Inf\"} %lu\n"), metric, route, (unsigned long)total);
+  }
+  if(label) route[strlen(route) - 1] = '\0'; // drop trailing comma
+  metricsOut(buf, len, label ? PSTR("%s_sum{%s} %lu\n") : PSTR("%s_sum%s %lu\n"), metric, route, (unsigned long)sum);
+  metricsOut(buf, len, label ? PSTR("%s_count{%s} %lu\n") : PSTR("%s_count%s %lu\n"), metric, route, (unsigned long)total);
+}
+
+/**
+ * record a completed scan duration
+ * @param ms scan duration
+ */
+void WiFiManager::metricsScan(uint32_t ms){
+  static const uint16_t bounds[WM_METRICS_SCAN_BUCKETS - 1] = {1000,2000,4000,8000};
+  uint8_t b = 0;
+  while(b < WM_METRICS_SCAN_BUCKETS - 1 && ms > bounds[b]) b++;
+  _metrics.scan[b]++;
+  _metrics.scans++;
+  _metrics.scanSum += ms;
+}
+
+const wm_metrics_t* WiFiManager::getMetrics(){
+  return &_metrics;
+}
+
+void WiFiManager::resetMetrics(){
+  unsigned long start = _metrics.portalStart;
+  memset(&_metrics, 0, sizeof(_metrics));
+  _metrics.portalStart = start;
+}
+#endif
+
 /** 
  * HTTPD CALLBACK save form and redirect to WLAN config page again
  */
@@ -1824,11 +2917,11 @@ void WiFiManager::handleWifiSave() {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP WiFi save "));
   DEBUG_WM(WM_DEBUG_DEV,F("Method:"),server->method() == HTTP_GET  ? (String)FPSTR(S_GET) : (String)FPSTR(S_POST));
   #endif
-  handleRequest();
+  handleRequest(WM_ROUTE_WIFISAVE);
 
   //SAVE/connect here
-  _ssid = server->arg(F("s")).c_str();
-  _pass = server->arg(F("p")).c_str();
+  _ssid = argValue(F("s")).c_str();
+  _pass = argValue(F("p")).c_str();
 
   if(_ssid == "" && _pass != ""){
     _ssid = WiFi_SSID(true); // password change, placeholder ssid, @todo compare pass to old?, confirm ssid is clean
@@ -1854,30 +2947,30 @@ void WiFiManager::handleWifiSave() {
   #endif
 
   // set static ips from server args
-  if (server->arg(FPSTR(S_ip)) != "") {
+  String ip = argValue(FPSTR(S_ip));
+  if (ip != "") {
     //_sta_static_ip.fromString(server->arg(FPSTR(S_ip));
-    String ip = server->arg(FPSTR(S_ip));
     optionalIPFromString(&_sta_static_ip, ip.c_str());
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_DEV,F("static ip:"),ip);
     #endif
   }
-  if (server->arg(FPSTR(S_gw)) != "") {
-    String gw = server->arg(FPSTR(S_gw));
+  String gw = argValue(FPSTR(S_gw));
+  if (gw != "") {
     optionalIPFromString(&_sta_static_gw, gw.c_str());
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_DEV,F("static gateway:"),gw);
     #endif
   }
-  if (server->arg(FPSTR(S_sn)) != "") {
-    String sn = server->arg(FPSTR(S_sn));
+  String sn = argValue(FPSTR(S_sn));
+  if (sn != "") {
     optionalIPFromString(&_sta_static_sn, sn.c_str());
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_DEV,F("static netmask:"),sn);
     #endif
   }
-  if (server->arg(FPSTR(S_dns)) != "") {
-    String dns = server->arg(FPSTR(S_dns));
+  String dns = argValue(FPSTR(S_dns));
+  if (dns != "") {
     optionalIPFromString(&_sta_static_dns, dns.c_str());
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_DEV,F("static DNS:"),dns);
@@ -1890,16 +2983,9 @@ void WiFiManager::handleWifiSave() {
 
   if(_paramsInWifi) doParamSave();
 
-  String page;
-
-  if(_ssid == ""){
-    page = getHTTPHead(FPSTR(S_titlewifisettings), FPSTR(C_wifi)); // @token titleparamsaved
-    page += FPSTR(HTTP_PARAMSAVED);
-  }
-  else {
-    page = getHTTPHead(FPSTR(S_titlewifisaved), FPSTR(C_wifi)); // @token titlewifisaved
-    page += FPSTR(HTTP_SAVED);
-  }
+  String &page = getHTTPHead(_ssid == "" ? FPSTR(S_titlewifisettings) : FPSTR(S_titlewifisaved), FPSTR(C_wifi)); // @token titleparamsaved @token titlewifisaved
+  if(_ssid == "") page += FPSTR(HTTP_PARAMSAVED);
+  else page += FPSTR(HTTP_SAVED);
 
   if(_showBack) page += FPSTR(HTTP_BACKBTN);
   page += getHTTPEnd();
@@ -1922,66 +3008,856 @@ void WiFiManager::handleParamSave() {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_DEV,F("Method:"),server->method() == HTTP_GET  ? (String)FPSTR(S_GET) : (String)FPSTR(S_POST));
   #endif
-  handleRequest();
+  handleRequest(WM_ROUTE_PARAMSAVE);
+
+  doParamSave(getParamGroupArg(getParamGroups()));
+
+  String &page = getHTTPHead(FPSTR(S_titleparamsaved), FPSTR(C_param)); // @token titleparamsaved
+  page += FPSTR(HTTP_PARAMSAVED);
+  if(_showBack) page += FPSTR(HTTP_BACKBTN); 
+  page += getHTTPEnd();
+
+  HTTPSend(page);
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("Sent param save page"));
+  #endif
+}
+
+/**
+ * param group names in order of first use, NULL for ungrouped params,
+ * empty if no param has a group (single page)
+ */
+std::vector<const char*> WiFiManager::getParamGroups(){
+  std::vector<const char*> groups;
+  bool grouped = false;
+  for (int i = 0; i < _paramsCount; i++) {
+    const char *group = _params[i]->getGroup();
+    if(group) grouped = true;
+    bool found = false;
+    for(auto g : groups){
+      if(WM_groupEq(g, group)){
+        found = true;
+        break;
+      }
+    }
+    if(!found) groups.push_back(group);
+  }
+  if(!grouped) groups.clear();
+  return groups;
+}
+
+/**
+ * requested param group from S_paramgroup arg, first group if none or out of range
+ * @param const char arg g value, NULL to read it from the request
+ * @return int group index, -1 if params are not grouped
+ */
+int WiFiManager::getParamGroupArg(const std::vector<const char*> &groups, const char *arg){
+  if(groups.empty()) return -1;
+  int g = arg ? atoi(arg) : argValue(FPSTR(S_paramgroup)).toInt();
+  return (g < 0 || g >= (int)groups.size()) ? 0 : g;
+}
+
+/**
+ * save posted param values
+ * @param int group only save params of this group index (from getParamGroups), -1 for all
+ */
+void WiFiManager::doParamSave(int group){
+  #ifdef WM_STREAMFORM
+  bool streamed = _formStreamed; // param values already applied while the body was read
+  #else
+  bool streamed = false;
+  #endif
+
+  if(!streamed) paramSaveStart();
+
+  //parameters
+  #ifdef WM_STREAMFORM
+  if(_paramsCount > 0 && (!streamed || _formParams)){
+  #else
+  if(_paramsCount > 0){
+  #endif
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Parameters"));
+    DEBUG_WM(WM_DEBUG_VERBOSE,FPSTR(D_HR));
+    #endif
+
+    const char *groupName = NULL;
+    if(group >= 0){
+      std::vector<const char*> groups = getParamGroups();
+      if(group < (int)groups.size()) groupName = groups[group];
+      else group = -1;
+    }
+
+    for (int i = 0; i < _paramsCount; i++) {
+      if (_params[i] == NULL || _params[i]->_length > 99999) {
+        #ifdef WM_DEBUG_LEVEL
+        DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] WiFiManagerParameter is out of scope"));
+        #endif
+        break; // @todo might not be needed anymore
+      }
+      if(!_params[i]->getID()) continue; // custom html
+      if(group >= 0 && !WM_groupEq(_params[i]->getGroup(), groupName)){
+        #ifdef WM_STREAMFORM
+        if(streamed && _params[i]->_posted) paramRestore(_params[i]); // streamed before the group field
+        #endif
+        continue; // not on posted page
+      }
+      if(streamed){
+        if(!_params[i]->_posted) paramSaveValue(_params[i], ""); // not posted, eg. unchecked checkbox
+        continue;
+      }
+      //read parameter from server, param_<i> else by id
+      paramSaveValue(_params[i], argValue(paramArgIndex(i)).c_str());
+    }
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,FPSTR(D_HR));
+    #endif
+  }
+
+  paramSaveEnd();
+}
+
+/**
+ * end of a params save, store and fire callbacks
+ */
+void WiFiManager::paramSaveEnd(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("Parameters changed:"),_paramsChanged);
+  #endif
+
+  #ifdef WM_PARAMSTORE
+  if(_paramFS) saveParameters();
+  #endif
+
+  // after all values are stored, callbacks see the new set
+  for(auto &c : _paramsOld){
+    WiFiManagerParameter *p = c.first;
+    if(p->_changecallback) p->_changecallback(p, c.second.c_str()); // @CALLBACK
+    if(_paramchangecallback) _paramchangecallback(p, c.second.c_str()); // @CALLBACK
+  }
+  _paramsOld.clear();
+
+   if ( _saveparamscallback != NULL) {
+    _saveparamscallback();  // @CALLBACK
+  }
+   
+}
+
+/**
+ * start of a params save, before any value is stored
+ */
+void WiFiManager::paramSaveStart(){
+   // @todo use new callback for before paramsaves, is this really needed?
+  if ( _presaveparamscallback != NULL) {
+    _presaveparamscallback();  // @CALLBACK
+  }
+  _paramsChanged = 0;
+  _paramsOld.clear();
+  for (int i = 0; i < _paramsCount; i++) {
+    if(!_params[i]) continue;
+    _params[i]->_changed = false;
+    _params[i]->_posted  = false;
+  }
+}
+
+/**
+ * store a posted value in a param, if valid and changed
+ * previous value is kept for change callbacks
+ */
+void WiFiManager::paramSaveValue(WiFiManagerParameter *p, const char *value){
+  p->_posted = true;
+  // longer than the param would be stored truncated, which is not the value validated
+  if(strlen(value) > (size_t)p->_length || !p->validate(value)){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] invalid value, not saved:"),(String)p->getID() + " " + value);
+    #endif
+    return;
+  }
+
+  // unchanged, nothing to store
+  if(strncmp(p->_value, value, p->_length) == 0) return;
+
+  //store it in params array
+  bool keepOld = p->_changecallback || _paramchangecallback;
+  #ifdef WM_STREAMFORM
+  keepOld = keepOld || _formStreamed; // rolled back if the body is aborted
+  #endif
+  if(keepOld) _paramsOld.push_back(std::make_pair(p, String(p->_value)));
+  p->_dirty   = true;
+  p->_changed = true;
+  _paramsChanged++;
+  strncpy(p->_value, value, p->_length);
+  p->_value[p->_length] = '\0'; // length+1 null terminated
+  p->parse();
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,(String)p->getID() + ":",p->_value);
+  #endif
+}
+
+#ifdef WM_STREAMFORM
+void WiFiManager::formRaw(HTTPRaw &raw){
+  switch(raw.status){
+    case RAW_START: {
+      formEnd();
+      // value buffer, largest param or wifi password
+      size_t bytes = 64;
+      for (int i = 0; i < _paramsCount; i++) {
+        if(_params[i] && _params[i]->getID() && (size_t)_params[i]->_length > bytes) bytes = _params[i]->_length;
+      }
+      _formStreamed = true; // body is consumed either way, server has no args for it
+      bytes++; // one over, so over-long values are seen as such instead of truncated to fit
+      _formValue.reset(new (std::nothrow) char[bytes + 1]);
+      if(!_formValue){
+        #ifdef WM_DEBUG_LEVEL
+        DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] failed to alloc form buffer, nothing saved"));
+        #endif
+        return;
+      }
+      _formValueMax = bytes;
+      // params are only saved from paramsave, or wifisave with params in wifi
+      _formParams   = _paramsInWifi || strcmp_P(server->uri().c_str(), R_paramsave) == 0;
+      if(_formParams) paramSaveStart();
+      break;
+    }
+    case RAW_WRITE:
+      if(!_formValue) return;
+      for(size_t i = 0; i < raw.currentSize; i++) formChar(raw.buf[i]);
+      break;
+    case RAW_END:
+      if(!_formValue) return;
+      formChar('&'); // last field
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_DEV,F("form body streamed bytes:"),raw.totalSize);
+      #endif
+      break;
+    case RAW_ABORTED:
+      if(_formParams) formRollback();
+      formEnd();
+      break;
+  }
+}
+
+void WiFiManager::formChar(char c){
+  // percent decode
+  if(_formHex){
+    int8_t d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+    if(d < 0){ _formHex = 0; return; } // malformed, drop
+    _formHexVal = (_formHexVal << 4) | d;
+    if(--_formHex) return;
+    c = (char)_formHexVal;
+    _formHexVal = 0;
+  }
+  else if(c == '%'){ _formHex = 2; return; }
+  else if(c == '&'){ formField(); return; }
+  else if(c == '=' && !_formInValue){ _formInValue = true; return; }
+  else if(c == '+') c = ' ';
+
+  if(!_formInValue){
+    if(_formNameLen < sizeof(_formName) - 1) _formName[_formNameLen++] = c;
+  }
+  else if(_formValueLen < _formValueMax) _formValue[_formValueLen++] = c; // longer than any param, truncated, still too long for it
+}
+
+void WiFiManager::formField(){
+  _formName[_formNameLen] = '\0';
+  _formValue[_formValueLen] = '\0';
+  if(_formNameLen > 0){
+    // param_<n> or param id, stored now
+    WiFiManagerParameter *p = NULL;
+    const size_t prelen = strlen_P(S_parampre);
+    if(strncmp_P(_formName, S_parampre, prelen) == 0){
+      char *end;
+      long n = strtol(_formName + prelen, &end, 10);
+      if(end != _formName + prelen && *end == '\0' && n >= 0 && n < _paramsCount) p = _params[n];
+    }
+    if(!p) p = getParameter(_formName);
+    if(_formGroup >= 0 && p && !WM_groupEq(p->getGroup(), _formGroupName)) p = NULL; // not on posted page, as doParamSave(group)
+    if(_formParams && p && p->getID()){
+      if(!p->_posted) paramSaveValue(p, _formValue.get()); // first wins, as server->arg()
+    }
+    else {
+      if(_formParams && strcmp_P(_formName, S_paramgroup) == 0){
+        // posted group, first field of a grouped param page, params after it are filtered
+        std::vector<const char*> groups = getParamGroups();
+        _formGroup = getParamGroupArg(groups, _formValue.get());
+        if(_formGroup >= 0) _formGroupName = groups[_formGroup];
+      }
+      _formArgs.push_back(std::make_pair(String(_formName), String(_formValue.get())));
+    }
+  }
+  _formNameLen  = 0;
+  _formValueLen = 0;
+  _formInValue  = false;
+  _formHex      = 0;
+}
+
+// put back the value a streamed field stored in p, as if it was not posted
+void WiFiManager::paramRestore(WiFiManagerParameter *p){
+  p->_posted = false;
+  for(auto it = _paramsOld.begin(); it != _paramsOld.end(); ++it){
+    if(it->first != p) continue;
+    strncpy(p->_value, it->second.c_str(), p->_length);
+    p->_value[p->_length] = '\0';
+    p->parse();
+    if(p->_changed && _paramsChanged) _paramsChanged--;
+    p->_changed = false;
+    _paramsOld.erase(it);
+    return;
+  }
+}
+
+// body aborted, restore params stored from its fields so far, nothing saved
+void WiFiManager::formRollback(){
+  while(!_paramsOld.empty()) paramRestore(_paramsOld.back().first);
+  _paramsChanged = 0;
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] form body aborted, params not saved"));
+  #endif
+}
+
+// request done, release form state
+void WiFiManager::formEnd(){
+  _formStreamed = false;
+  _formParams   = false;
+  _formGroup    = -1;
+  _formGroupName = NULL;
+  _formValue.reset();
+  _formValueMax = 0;
+  _formArgs.clear();
+  _formNameLen  = 0;
+  _formValueLen = 0;
+  _formInValue  = false;
+  _formHex      = 0;
+  _formHexVal   = 0;
+}
+#endif
+
+#ifdef WM_CONFIGIO
+/**
+ * Config export / import
+ * {"v":1,"ssid":"..","pass":"..","params":{"id":"value",..}}
+ * params are exported as their string values, import validates everything before applying anything
+ */
+static void WM_jsonOut(String &out, const char *str){
+  out += '"';
+  for(; *str; str++){
+    char c = *str;
+    if(c == '"' || c == '\\'){ out += '\\'; out += c; }
+    else if((uint8_t)c < 0x20){
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    }
+    else out += c;
+  }
+  out += '"';
+}
+
+static const char* WM_jsonWs(const char *p){
+  while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+  return p;
+}
+
+// @return after closing quote, NULL if malformed
+static const char* WM_jsonIn(const char *p, String &out){
+  p = WM_jsonWs(p);
+  if(*p++ != '"') return NULL;
+  out = "";
+  while(*p && *p != '"'){
+    char c = *p++;
+    if(c != '\\'){ out += c; continue; }
+    c = *p++;
+    switch(c){
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': {
+        char hex[5] = {0};
+        for(uint8_t i = 0; i < 4; i++){
+          if(!isxdigit(*p)) return NULL;
+          hex[i] = *p++;
+        }
+        uint16_t u = strtol(hex, NULL, 16); // bmp only, utf-8 encoded
+        if(u == 0) return NULL; // would truncate the c string
+        if(u < 0x80) out += (char)u;
+        else if(u < 0x800){ out += (char)(0xC0 | (u >> 6)); out += (char)(0x80 | (u & 0x3F)); }
+        else { out += (char)(0xE0 | (u >> 12)); out += (char)(0x80 | ((u >> 6) & 0x3F)); out += (char)(0x80 | (u & 0x3F)); }
+        break;
+      }
+      case '\0': return NULL;
+      default: out += c; // " \ /
+    }
+  }
+  if(*p != '"') return NULL;
+  return p + 1;
+}
+
+// after an object member, @return next member or closing brace, NULL if no separator or trailing comma
+static const char* WM_jsonNext(const char *p){
+  p = WM_jsonWs(p);
+  if(*p == '}') return p;
+  if(*p != ',') return NULL;
+  p = WM_jsonWs(p + 1);
+  return *p == '}' ? NULL : p;
+}
+
+/**
+ * getConfigOut
+ * saved wifi credentials and all parameter values as json
+ * the password is only included if setShowPassword(true), as on the wifi page
+ * @since $dev
+ * @param  bool credentials include ssid (and password)
+ * @return String
+ */
+String WiFiManager::getConfigOut(bool credentials){
+  String out = F("{\"v\":1");
+  if(credentials){
+    out += F(",\"ssid\":");
+    WM_jsonOut(out, WiFi_SSID(true).c_str());
+    if(_showPassword){
+      out += F(",\"pass\":");
+      WM_jsonOut(out, WiFi_psk(true).c_str());
+    }
+  }
+  out += F(",\"params\":{");
+  bool first = true;
+  for (int i = 0; i < _paramsCount; i++) {
+    if(!_params[i] || !_params[i]->getID()) continue;
+    if(!first) out += ',';
+    first = false;
+    WM_jsonOut(out, _params[i]->getID());
+    out += ':';
+    WM_jsonOut(out, _params[i]->getValue());
+  }
+  out += F("}}");
+  return out;
+}
+
+/**
+ * setConfig
+ * apply a getConfigOut document, all or nothing, unknown param ids are ignored
+ * params are saved as from the param page (validation, store, change and save callbacks),
+ * ssid/pass are applied as from the wifi page, the portal connects with them,
+ * so a document with ssid is rejected when no config or web portal is running
+ * @since $dev
+ * @param  const char json
+ * @param  String     error set on failure
+ * @return bool false if the document is malformed or a value is invalid, nothing applied
+ */
+bool WiFiManager::setConfig(const char *json, String &error){
+  String ssid, pass, key, value;
+  bool hasSSID = false, hasPass = false;
+  std::vector<std::pair<WiFiManagerParameter*, String>> values;
+
+  const char *p = WM_jsonWs(json);
+  if(*p++ != '{'){ error = F("expected object"); return false; }
+  p = WM_jsonWs(p);
+  while(*p && *p != '}'){
+    p = WM_jsonIn(p, key);
+    if(!p || *(p = WM_jsonWs(p)) != ':'){ error = F("expected key"); return false; }
+    p = WM_jsonWs(p + 1);
+    if(key == "v"){
+      if(strtol(p, (char**)&p, 10) != 1){ error = F("unsupported version"); return false; }
+    }
+    else if(key == "ssid"){
+      if(!(p = WM_jsonIn(p, ssid))){ error = F("bad ssid"); return false; }
+      hasSSID = true;
+    }
+    else if(key == "pass"){
+      if(!(p = WM_jsonIn(p, pass))){ error = F("bad pass"); return false; }
+      hasPass = true;
+    }
+    else if(key == "params"){
+      if(*p++ != '{'){ error = F("params expected object"); return false; }
+      p = WM_jsonWs(p);
+      while(*p && *p != '}'){
+        p = WM_jsonIn(p, key);
+        if(!p || *(p = WM_jsonWs(p)) != ':' || !(p = WM_jsonIn(p + 1, value))){ error = F("params expected string values"); return false; }
+        WiFiManagerParameter *param = getParameter(key.c_str());
+        if(param){
+          if(value.length() > (size_t)param->getValueLength()){ error = (String)F("value too long for ") + key; return false; }
+          if(!param->validate(value.c_str())){ error = (String)F("invalid value for ") + key; return false; }
+          values.push_back(std::make_pair(param, value));
+        }
+        if(!(p = WM_jsonNext(p))){ error = F("params expected , or }"); return false; }
+      }
+      if(*p++ != '}'){ error = F("unterminated params"); return false; }
+    }
+    else { error = (String)F("unknown key ") + key; return false; }
+    if(!(p = WM_jsonNext(p))){ error = F("expected , or }"); return false; }
+  }
+  if(*p != '}'){ error = F("unterminated object"); return false; }
+  if(hasSSID && !configPortalActive && !webPortalActive){ error = F("ssid needs a running portal"); return false; }
+
+  // valid, apply
+  if(!values.empty()){
+    paramSaveStart();
+    for(auto &v : values) paramSaveValue(v.first, v.second.c_str());
+    paramSaveEnd();
+  }
+  if(hasSSID){
+    // export without password (setShowPassword off), keep the saved one for the same ssid
+    if(!hasPass && ssid == WiFi_SSID(true)) pass = WiFi_psk(true);
+    _ssid = ssid;
+    _pass = pass;
+    if (_presavewificallback != NULL) {
+      _presavewificallback();  // @CALLBACK
+    }
+    connect = true; //signal ready to connect/reset process in processConfigPortal
+  }
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("config imported params:"),values.size());
+  #endif
+  return true;
+}
+
+/**
+ * HTTPD CALLBACK config export, json
+ */
+void WiFiManager::handleConfigExport(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Config Export"));
+  #endif
+  handleRequest(WM_ROUTE_CONFIGEXPORT);
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  server->send(200, FPSTR(HTTP_HEAD_CT_JSON), getConfigOut());
+  routeEnd();
+}
+
+/**
+ * HTTPD CALLBACK config import, POST json body
+ */
+void WiFiManager::handleConfigImport(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Config Import"));
+  #endif
+  handleRequest(WM_ROUTE_CONFIGIMPORT);
+  if(server->method() != HTTP_POST){
+    server->send(405, FPSTR(HTTP_HEAD_CT2), F("POST json"));
+    routeEnd();
+    return;
+  }
+  String error;
+  if(!setConfig(server->arg(F("plain")).c_str(), error)){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] config import:"),error);
+    #endif
+    server->send(400, FPSTR(HTTP_HEAD_CT2), error);
+    routeEnd();
+    return;
+  }
+  String out = (String)F("{\"changed\":") + String(_paramsChanged) + F(",\"connect\":") + (connect ? F("true") : F("false")) + '}';
+  server->send(200, FPSTR(HTTP_HEAD_CT_JSON), out);
+  routeEnd();
+}
+#endif
+
+#ifdef WM_PARAMSTORE
+/**
+ * Parameter store
+ * file is a 4 byte header (WMP, version) followed by a journal of records
+ * [id len u8][id][value len u16][value][crc32 u32], little endian, crc over the record
+ * load reads records in order, last record for an id wins, stops at the first bad record (torn write)
+ * save appends records for changed params only, the journal is rewritten with current values
+ * when it holds too many stale records, via a temp file and rename
+ */
+static const uint8_t WM_PARAMSTORE_VERSION = 1;
+
+static uint32_t WM_crc32(uint32_t crc, const uint8_t *data, size_t len){
+  crc = ~crc;
+  while(len--){
+    crc ^= *data++;
+    for(uint8_t k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static bool WM_paramRecordWrite(File &f, const char *id, const char *value){
+  uint8_t  idlen  = strlen(id);
+  uint16_t vallen = strlen(value);
+  uint8_t  len[2] = { (uint8_t)vallen, (uint8_t)(vallen >> 8) };
+  uint32_t crc    = WM_crc32(0, &idlen, 1);
+  crc = WM_crc32(crc, (const uint8_t*)id, idlen);
+  crc = WM_crc32(crc, len, 2);
+  crc = WM_crc32(crc, (const uint8_t*)value, vallen);
+  uint8_t  crcb[4] = { (uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24) };
+  return f.write(&idlen, 1) == 1
+      && f.write((const uint8_t*)id, idlen) == idlen
+      && f.write(len, 2) == 2
+      && f.write((const uint8_t*)value, vallen) == vallen
+      && f.write(crcb, 4) == 4;
+}
+
+/**
+ * setParamStore
+ * @since $dev
+ * @param fs::FS     fs   mounted filesystem, LittleFS, SPIFFS etc.
+ * @param const char path store file, default /wmparams.bin
+ */
+void WiFiManager::setParamStore(fs::FS &fs, const char *path){
+  _paramFS      = &fs;
+  _paramPath    = path;
+  _paramRecords = 0;
+}
+
+/**
+ * loadParameters
+ * @since $dev
+ * @return bool false if there is no valid store
+ */
+bool WiFiManager::loadParameters(){
+  if(!_paramFS) return false;
+
+  String tmp = (String)_paramPath + F(".tmp");
+  if(!_paramFS->exists(_paramPath) && _paramFS->exists(tmp.c_str())){
+    _paramFS->rename(tmp.c_str(), _paramPath); // compaction interrupted after remove
+  }
+
+  File f = _paramFS->open(_paramPath, "r");
+  if(!f) return false;
+
+  uint8_t head[4];
+  if(f.read(head, 4) != 4 || head[0] != 'W' || head[1] != 'M' || head[2] != 'P' || head[3] != WM_PARAMSTORE_VERSION){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] param store invalid header"));
+    #endif
+    f.close();
+    return false;
+  }
+
+  _paramRecords = 0;
+  bool torn = false;
+  char id[256];
+  uint8_t idlen;
+  while(f.read(&idlen, 1) == 1){
+    uint8_t len[2], crcb[4];
+    if(f.read((uint8_t*)id, idlen) != idlen || f.read(len, 2) != 2){
+      torn = true;
+      break;
+    }
+    id[idlen] = '\0';
+    uint16_t vallen = len[0] | (len[1] << 8);
+    std::unique_ptr<char[]> value(new (std::nothrow) char[vallen + 1]);
+    if(!value || f.read((uint8_t*)value.get(), vallen) != vallen || f.read(crcb, 4) != 4){
+      torn = true;
+      break;
+    }
+    value[vallen] = '\0';
+    uint32_t crc = WM_crc32(0, &idlen, 1);
+    crc = WM_crc32(crc, (const uint8_t*)id, idlen);
+    crc = WM_crc32(crc, len, 2);
+    crc = WM_crc32(crc, (const uint8_t*)value.get(), vallen);
+    if(crc != (crcb[0] | (crcb[1] << 8) | ((uint32_t)crcb[2] << 16) | ((uint32_t)crcb[3] << 24))){
+      torn = true;
+      break;
+    }
+    _paramRecords++;
+
+    WiFiManagerParameter *p = getParameter(id);
+    if(p){
+      if(p->validate(value.get())) p->setValue(value.get(), p->_length);
+      p->_dirty = false;
+    }
+  }
+  f.close();
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("param store records loaded:"),_paramRecords);
+  #endif
+  if(torn){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] param store truncated, compacting"));
+    #endif
+    compactParameters(); // drop the bad tail, appends after it would never load
+  }
+  return true;
+}
+
+/**
+ * saveParameters
+ * @since $dev
+ * @return bool success
+ */
+bool WiFiManager::saveParameters(){
+  if(!_paramFS) return false;
 
-  doParamSave();
+  uint16_t dirty = 0;
+  for (int i = 0; i < _paramsCount; i++) {
+    if(_params[i] && _params[i]->_id && _params[i]->_dirty) dirty++;
+  }
+  if(dirty == 0) return true;
 
-  String page = getHTTPHead(FPSTR(S_titleparamsaved), FPSTR(C_param)); // @token titleparamsaved
-  page += FPSTR(HTTP_PARAMSAVED);
-  if(_showBack) page += FPSTR(HTTP_BACKBTN); 
-  page += getHTTPEnd();
+  // too many stale records, or no store yet
+  if(_paramRecords == 0 || _paramRecords + dirty > 2 * _paramsCount + 8 || !_paramFS->exists(_paramPath)){
+    return compactParameters();
+  }
 
-  HTTPSend(page);
+  File f = _paramFS->open(_paramPath, "a");
+  if(!f) return false;
+  bool ret = true;
+  for (int i = 0; i < _paramsCount && ret; i++) {
+    WiFiManagerParameter *p = _params[i];
+    if(!p || !p->_id || !p->_dirty) continue;
+    ret = WM_paramRecordWrite(f, p->_id, p->_value);
+    if(ret){
+      p->_dirty = false;
+      _paramRecords++;
+    }
+  }
+  f.close();
 
   #ifdef WM_DEBUG_LEVEL
-  DEBUG_WM(WM_DEBUG_DEV,F("Sent param save page"));
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("param store records appended:"),dirty);
+  if(!ret) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] param store write failed"));
   #endif
+  return ret;
 }
 
-void WiFiManager::doParamSave(){
-   // @todo use new callback for before paramsaves, is this really needed?
-  if ( _presaveparamscallback != NULL) {
-    _presaveparamscallback();  // @CALLBACK
+/**
+ * compactParameters
+ * @since $dev
+ * @return bool success
+ */
+bool WiFiManager::compactParameters(){
+  if(!_paramFS) return false;
+
+  String tmp = (String)_paramPath + F(".tmp");
+  File f = _paramFS->open(tmp.c_str(), "w");
+  if(!f) return false;
+
+  const uint8_t head[4] = { 'W', 'M', 'P', WM_PARAMSTORE_VERSION };
+  bool ret = f.write(head, 4) == 4;
+  uint16_t records = 0;
+  for (int i = 0; i < _paramsCount && ret; i++) {
+    WiFiManagerParameter *p = _params[i];
+    if(!p || !p->_id) continue;
+    ret = WM_paramRecordWrite(f, p->_id, p->_value);
+    records++;
   }
+  f.close();
 
-  //parameters
-  if(_paramsCount > 0){
-    #ifdef WM_DEBUG_LEVEL
-    DEBUG_WM(WM_DEBUG_VERBOSE,F("Parameters"));
-    DEBUG_WM(WM_DEBUG_VERBOSE,FPSTR(D_HR));
-    #endif
-
+  if(ret){
+    _paramFS->remove(_paramPath);
+    ret = _paramFS->rename(tmp.c_str(), _paramPath);
+  }
+  if(ret){
+    _paramRecords = records;
     for (int i = 0; i < _paramsCount; i++) {
-      if (_params[i] == NULL || _params[i]->_length > 99999) {
-        #ifdef WM_DEBUG_LEVEL
-        DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] WiFiManagerParameter is out of scope"));
-        #endif
-        break; // @todo might not be needed anymore
-      }
-      //read parameter from server
-      String name = (String)FPSTR(S_parampre)+(String)i;
-      String value;
-      if(server->hasArg(name)) {
-        value = server->arg(name);
-      } else {
-        value = server->arg(_params[i]->getID());
-      }
+      if(_params[i]) _params[i]->_dirty = false;
+    }
+  }
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("param store compacted, records:"),records);
+  if(!ret) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] param store compact failed"));
+  #endif
+  return ret;
+}
+#endif
 
-      //store it in params array
-      value.toCharArray(_params[i]->_value, _params[i]->_length+1); // length+1 null terminated
+/**
+ * index posted args once per request
+ * param_<n> args resolve directly to param n, other names go in a hash slot table,
+ * lookups are then constant time instead of a scan of all args each
+ */
+void WiFiManager::indexArgs(){
+  if(_argsIndexed) return;
+  _argsIndexed = true;
+
+  int args = server->args();
+  uint16_t size = 16;
+  while(size < args * 2) size <<= 1;
+  if(size > _argSlotsSize){
+    uint16_t *slots = (uint16_t*)realloc(_argSlots, size * sizeof(uint16_t));
+    if(!slots){
       #ifdef WM_DEBUG_LEVEL
-      DEBUG_WM(WM_DEBUG_VERBOSE,(String)_params[i]->getID() + ":",value);
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] failed to alloc arg index"));
       #endif
+      _argsIndexed = false; // lookups fall back to server
+      return;
     }
-    #ifdef WM_DEBUG_LEVEL
-    DEBUG_WM(WM_DEBUG_VERBOSE,FPSTR(D_HR));
-    #endif
+    _argSlots     = slots;
+    _argSlotsSize = size;
+  }
+  if(_paramsCount > _argParamsSize){
+    uint16_t *params = (uint16_t*)realloc(_argParams, _paramsCount * sizeof(uint16_t));
+    if(!params){
+      _argsIndexed = false;
+      return;
+    }
+    _argParams     = params;
+    _argParamsSize = _paramsCount;
   }
+  _argSlotsMask = size - 1;
+  memset(_argSlots, 0, size * sizeof(uint16_t));
+  if(_argParams) memset(_argParams, 0, _argParamsSize * sizeof(uint16_t));
+
+  const size_t prelen = strlen_P(S_parampre);
+  for(int i = 0; i < args; i++){
+    const String &name = server->argName(i);
+    if(strncmp_P(name.c_str(), S_parampre, prelen) == 0){
+      const char *num = name.c_str() + prelen;
+      char *end;
+      long n = strtol(num, &end, 10);
+      if(end != num && *end == '\0' && n >= 0 && n < _paramsCount){
+        if(!_argParams[n]) _argParams[n] = i + 1; // first wins, as server->arg()
+        continue;
+      }
+    }
+    uint16_t slot = WM_hash(name.c_str()) & _argSlotsMask;
+    while(_argSlots[slot]) slot = (slot + 1) & _argSlotsMask;
+    _argSlots[slot] = i + 1;
+  }
+}
 
-   if ( _saveparamscallback != NULL) {
-    _saveparamscallback();  // @CALLBACK
+/**
+ * posted arg lookup by name
+ * @return int arg index or -1
+ */
+int WiFiManager::argIndex(const char *name){
+  indexArgs();
+  if(!_argsIndexed){
+    for(int i = 0; i < server->args(); i++) if(server->argName(i) == name) return i;
+    return -1;
   }
-   
+  uint16_t slot = WM_hash(name) & _argSlotsMask;
+  while(_argSlots[slot]){
+    int i = _argSlots[slot] - 1;
+    if(server->argName(i) == name) return i;
+    slot = (slot + 1) & _argSlotsMask;
+  }
+  return -1;
+}
+
+/**
+ * posted arg for parameter, param_<i> else parameter id
+ * @return int arg index or -1
+ */
+int WiFiManager::paramArgIndex(int i){
+  indexArgs();
+  if(_argsIndexed && i < _argParamsSize && _argParams[i]) return _argParams[i] - 1;
+  if(!_argsIndexed){
+    int idx = argIndex(((String)FPSTR(S_parampre) + (String)i).c_str());
+    if(idx >= 0) return idx;
+  }
+  return argIndex(_params[i]->getID());
+}
+
+String WiFiManager::argValue(int idx){
+  if(idx < 0) return "";
+  return server->arg(idx);
+}
+
+String WiFiManager::argValue(const __FlashStringHelper *name){
+  #ifdef WM_STREAMFORM
+  if(_formStreamed){
+    for(auto &a : _formArgs) if(strcmp_P(a.first.c_str(), (PGM_P)name) == 0) return a.second;
+  }
+  #endif
+  return argValue(argIndex(String(name).c_str()));
 }
 
 /** 
@@ -1991,8 +3867,8 @@ void WiFiManager::handleInfo() {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Info"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleinfo), FPSTR(C_info)); // @token titleinfo
+  handleRequest(WM_ROUTE_INFO);
+  String &page = getHTTPHead(FPSTR(S_titleinfo), FPSTR(C_info)); // @token titleinfo
   reportStatus(page);
 
   uint16_t infos = 0;
@@ -2336,15 +4212,42 @@ void WiFiManager::handleExit() {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Exit"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleexit), FPSTR(C_exit)); // @token titleexit
+  handleRequest(WM_ROUTE_EXIT);
+  String &page = getHTTPHead(FPSTR(S_titleexit), FPSTR(C_exit)); // @token titleexit
   page += FPSTR(S_exiting); // @token exiting
   page += getHTTPEnd();
   // ('Logout', 401, {'WWW-Authenticate': 'Basic realm="Login required"'})
   server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
   HTTPSend(page);
-  delay(2000);
-  abort = true;
+  deferAction(WM_DEFER_EXIT, 2000);
+}
+
+/**
+ * schedule a portal action, run from processConfigPortal once ms have passed
+ * lets handlers return immediately while the response is flushed and other clients are served
+ * @param action wm_defer_t
+ * @param ms     delay
+ */
+void WiFiManager::deferAction(uint8_t action, unsigned long ms){
+  _deferAction = action;
+  _deferStart  = millis();
+  _deferDelay  = ms;
+}
+
+void WiFiManager::processDeferred(){
+  if(_deferAction == WM_DEFER_NONE || (millis() - _deferStart < _deferDelay)) return;
+  uint8_t action = _deferAction;
+  _deferAction = WM_DEFER_NONE;
+
+  if(action == WM_DEFER_EXIT){
+    abort = true;
+  }
+  else if(action == WM_DEFER_REBOOT){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(F("RESETTING ESP"));
+    #endif
+    reboot();
+  }
 }
 
 /** 
@@ -2354,18 +4257,14 @@ void WiFiManager::handleReset() {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Reset"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titlereset), FPSTR(C_restart)); //@token titlereset
+  handleRequest(WM_ROUTE_RESTART);
+  String &page = getHTTPHead(FPSTR(S_titlereset), FPSTR(C_restart)); //@token titlereset
   page += FPSTR(S_resetting); //@token resetting
   page += getHTTPEnd();
 
   HTTPSend(page);
 
-  #ifdef WM_DEBUG_LEVEL
-  DEBUG_WM(F("RESETTING ESP"));
-  #endif
-  delay(1000);
-  reboot();
+  deferAction(WM_DEFER_REBOOT, 1000);
 }
 
 /** 
@@ -2379,8 +4278,8 @@ void WiFiManager::handleErase(boolean opt) {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_NOTIFY,F("<- HTTP Erase"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleerase), FPSTR(C_erase)); // @token titleerase
+  handleRequest(WM_ROUTE_ERASE);
+  String &page = getHTTPHead(FPSTR(S_titleerase), FPSTR(C_erase)); // @token titleerase
 
   bool ret = erase(opt);
 
@@ -2395,21 +4294,17 @@ void WiFiManager::handleErase(boolean opt) {
   page += getHTTPEnd();
   HTTPSend(page);
 
-  if(ret){
-    delay(2000);
-    #ifdef WM_DEBUG_LEVEL
-  	DEBUG_WM(F("RESETTING ESP"));
-    #endif
-  	reboot();
-  }	
+  if(ret) deferAction(WM_DEFER_REBOOT, 2000);
 }
 
 /** 
  * HTTPD CALLBACK 404
  */
 void WiFiManager::handleNotFound() {
+  if (dispatchRoute()) return; // portal page
+  if (captivePortalProbe()) return; // known os connectivity check, answered from table
   if (captivePortal()) return; // If captive portal redirect instead of displaying the page
-  handleRequest();
+  handleRequest(WM_ROUTE_NOTFOUND);
   String message = FPSTR(S_notfound); // @token notfound
 
   bool verbose404 = false; // show info in 404 body, uri,method, args
@@ -2429,7 +4324,11 @@ void WiFiManager::handleNotFound() {
   server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
   server->sendHeader(F("Pragma"), F("no-cache"));
   server->sendHeader(F("Expires"), F("-1"));
+  #ifdef WM_LATENCY
+  _routeRendered = micros();
+  #endif
   server->send ( 404, FPSTR(HTTP_HEAD_CT2), message );
+  routeEnd();
 }
 
 /**
@@ -2441,37 +4340,188 @@ boolean WiFiManager::captivePortal() {
   
   if(!_enableCaptivePortal || !configPortalActive) return false; // skip redirections if cp not enabled or not in ap mode
   
-  String serverLoc =  toStringIp(server->client().localIP());
+  const String &serverLoc = captivePortalLoc();
 
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_DEV,"-> " + server->hostHeader());
   DEBUG_WM(WM_DEBUG_DEV,"serverLoc " + serverLoc);
   #endif
 
-  // fallback for ipv6 bug
-  if(serverLoc == "0.0.0.0"){
-    if ((WiFi.status()) != WL_CONNECTED)
-      serverLoc = toStringIp(WiFi.softAPIP());
-    else
-      serverLoc = toStringIp(WiFi.localIP());
-  }
-  
-  if(_httpPort != 80) serverLoc += ":" + (String)_httpPort; // add port if not default
   bool doredirect = serverLoc != server->hostHeader(); // redirect if hostheader not server ip, prevent redirect loops
   
   if (doredirect) {
-    #ifdef WM_DEBUG_LEVEL
-    DEBUG_WM(WM_DEBUG_VERBOSE,F("<- Request redirected to captive portal"));
-    DEBUG_WM(WM_DEBUG_DEV,"serverLoc " + serverLoc);
+    #ifdef WM_METRICS
+    _metrics.captiveRedirects++; // probes are counted apart, see captivePortalProbe
     #endif
-    server->sendHeader(F("Location"), (String)F("http://") + serverLoc, true); // @HTTPHEAD send redirect
-    server->send ( 302, FPSTR(HTTP_HEAD_CT2), ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
-    server->client().stop(); // Stop is needed because we sent no content length
+    _httpServed++;
+    captivePortalRedirect();
     return true;
   }
   return false;
 }
 
+/**
+ * captive portal host, server ip and port if not default
+ * host string and raw 302 response are rebuilt only when the ip or port changes
+ * @return String cached host
+ */
+const String& WiFiManager::captivePortalLoc() {
+  uint32_t ip = server->client().localIP();
+
+  // fallback for ipv6 bug
+  if(ip == 0){
+    if ((WiFi.status()) != WL_CONNECTED)
+      ip = WiFi.softAPIP();
+    else
+      ip = WiFi.localIP();
+  }
+
+  if(ip == _cpLocIP && _httpPort == _cpLocPort && _cpRedirect != "") return _cpLoc;
+
+  _cpLocIP   = ip;
+  _cpLocPort = _httpPort;
+  _cpLoc     = toStringIp(IPAddress(ip));
+  if(_httpPort != 80) _cpLoc += ":" + (String)_httpPort; // add port if not default
+
+  _cpRedirect = FPSTR(HTTP_302_START);
+  _cpRedirect += _cpLoc;
+  _cpRedirect += FPSTR(HTTP_302_END);
+
+  #ifdef WM_HTTPKEEPALIVE
+  if(_httpKeepAlive){
+    _cpRedirectKA = FPSTR(HTTP_302_START);
+    _cpRedirectKA += _cpLoc;
+    _cpRedirectKA += FPSTR(HTTP_302_END_KA);
+  }
+  #endif
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("captive redirect host:"),_cpLoc);
+  #endif
+  return _cpLoc;
+}
+
+/**
+ * send cached captive portal redirect, call captivePortalLoc() first
+ * written raw with content-length 0, socket is kept open if keep-alive allows, else closed
+ * not counted here, callers count it as a redirect or a probe
+ */
+void WiFiManager::captivePortalRedirect() {
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- Request redirected to captive portal"));
+  #endif
+  if(HTTPKeepAlive() && _cpRedirectKA != ""){
+    server->client().write((const uint8_t*)_cpRedirectKA.c_str(), _cpRedirectKA.length()); // @HTTPHEAD send redirect
+    return;
+  }
+  server->client().write((const uint8_t*)_cpRedirect.c_str(), _cpRedirect.length()); // @HTTPHEAD send redirect
+  server->client().stop();
+}
+
+/**
+ * Portal route dispatch
+ * request path is looked up in WM_DISPATCH by hash and the handler called directly,
+ * replaces a server->on() registration (std::function and path String) per route
+ * @return bool true if the path is a portal route and was handled
+ */
+boolean WiFiManager::dispatchRoute() {
+  // route index+1 by path hash, built once
+  static uint8_t routeSlots[64] = {0};
+  static bool    routeSlotsInit = false;
+  const uint8_t  mask = sizeof(routeSlots) - 1;
+
+  if(!routeSlotsInit){
+    WM_slotsBuild(routeSlots, mask, WM_DISPATCH, sizeof(wm_dispatch_route_t), _numdispatch);
+    routeSlotsInit = true;
+  }
+
+  int idx = WM_slotsFind(routeSlots, mask, WM_DISPATCH, sizeof(wm_dispatch_route_t), server->uri().c_str());
+  if(idx < 0) return false;
+
+  switch(pgm_read_byte(&WM_DISPATCH[idx].id)){
+    case WM_R_ROOT:       handleRoot(); break;
+    case WM_R_WIFI:       handleWifi(true); break;
+    case WM_R_WIFINOSCAN: handleWifi(false); break;
+    case WM_R_WIFISAVE:   handleWifiSave(); break;
+    case WM_R_INFO:       handleInfo(); break;
+    case WM_R_PARAM:      handleParam(); break;
+    case WM_R_PARAMSAVE:  handleParamSave(); break;
+    case WM_R_RESTART:    handleReset(); break;
+    case WM_R_EXIT:       handleExit(); break;
+    case WM_R_CLOSE:      handleClose(); break;
+    case WM_R_ERASE:      handleErase(false); break;
+    case WM_R_STATUS:     handleWiFiStatus(); break;
+    case WM_R_UPDATE:     handleUpdate(); break;
+    #ifdef WM_TRACE
+    case WM_R_TRACE:      handleTrace(); break;
+    #endif
+    #ifdef WM_HEAPSTATS
+    case WM_R_HEAP:       handleHeap(); break;
+    #endif
+    #ifdef WM_METRICS
+    case WM_R_METRICS:    handleMetrics(); break;
+    #endif
+    #ifdef WM_LATENCY
+    case WM_R_LATENCY:    handleLatency(); break;
+    #endif
+    #ifdef WM_CONFIGIO
+    case WM_R_CONFIGEXPORT: handleConfigExport(); break;
+    case WM_R_CONFIGIMPORT: handleConfigImport(); break;
+    #endif
+    default: return false;
+  }
+  return true;
+}
+
+/**
+ * Captive portal probe classifier
+ * OS connectivity checks (generate_204, hotspot-detect etc.) are looked up in WM_PROBES by path hash
+ * and answered with a redirect to the config portal, or with their minimal "online" response on the web portal.
+ * Probes never render pages or trigger scans, and do not count as web portal access
+ * @return bool true if the request was a known probe and was answered, false if captive portal is disabled or no portal runs
+ */
+boolean WiFiManager::captivePortalProbe() {
+  if(!_enableCaptivePortal || (!configPortalActive && !webPortalActive)) return false;
+
+  // probe index+1 by path hash, built once
+  static uint8_t probeSlots[32] = {0};
+  static bool    probeSlotsInit = false;
+  const uint8_t  mask = sizeof(probeSlots) - 1;
+
+  if(!probeSlotsInit){
+    WM_slotsBuild(probeSlots, mask, WM_PROBES, sizeof(wm_probe_t), _numprobes);
+    probeSlotsInit = true;
+  }
+
+  const String &uri = server->uri();
+  int idx = WM_slotsFind(probeSlots, mask, WM_PROBES, sizeof(wm_probe_t), uri.c_str());
+  if(idx < 0) return false;
+  const wm_probe_t *probe = &WM_PROBES[idx];
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Captive probe"),uri);
+  #endif
+  #ifdef WM_METRICS
+  _metrics.captiveProbes++;
+  #endif
+  _httpServed++;
+
+  if(configPortalActive){
+    captivePortalLoc();
+    captivePortalRedirect();
+    return true;
+  }
+
+  uint16_t code = pgm_read_word(&probe->code);
+  PGM_P body    = (PGM_P)pgm_read_ptr(&probe->body);
+  HTTPKeepAlive();
+  server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
+  if(body) server->send_P(code, pgm_read_byte(&probe->text) ? HTTP_HEAD_CT2 : HTTP_HEAD_CT, body);
+  else server->send(code, FPSTR(HTTP_HEAD_CT2), "");
+  return true;
+}
+
+
 void WiFiManager::stopCaptivePortal(){
   _enableCaptivePortal= false;
   // @todo maybe disable configportaltimeout(optional), or just provide callback for user
@@ -2484,8 +4534,8 @@ void WiFiManager::handleClose(){
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP close"));
   #endif
-  handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleclose), FPSTR(C_close)); // @token titleclose
+  handleRequest(WM_ROUTE_CLOSE);
+  String &page = getHTTPHead(FPSTR(S_titleclose), FPSTR(C_close)); // @token titleclose
   page += FPSTR(S_closing); // @token closing
   page += getHTTPEnd();
   HTTPSend(page);
@@ -2727,6 +4777,15 @@ void WiFiManager::setSaveConnectTimeout(unsigned long seconds) {
   _saveTimeout = seconds * 1000;
 }
 
+/**
+ * set autoConnectFast deadline
+ * @access public
+ * @param {[type]} unsigned long ms [description]
+ */
+void WiFiManager::setFastConnectTimeout(unsigned long ms) {
+  _fastConnectTimeout = ms;
+}
+
 /**
  * Set save portal connect on save option, 
  * if false, will only save credentials not connect
@@ -2875,6 +4934,24 @@ void WiFiManager::setSaveParamsCallback( std::function<void()> func ) {
   _saveparamscallback = func;
 }
 
+/**
+ * setParamChangeCallback, called on params save for each param that changed, after all values are stored
+ * @since $dev
+ * @param {[type]} void (*func)(WiFiManagerParameter* param, const char* oldValue)
+ */
+void WiFiManager::setParamChangeCallback( std::function<void(WiFiManagerParameter*, const char*)> func ) {
+  _paramchangecallback = func;
+}
+
+/**
+ * getParamsChangedCount
+ * @since $dev
+ * @return int params changed by the last params save, 0 if the save changed nothing
+ */
+int WiFiManager::getParamsChangedCount(){
+  return _paramsChanged;
+}
+
 /**
  * setPreSaveParamsCallback, set a pre save params callback on params save prior to anything else
  * @access public
@@ -3332,6 +5409,59 @@ void WiFiManager::setHttpPort(uint16_t port){
   _httpPort = port;
 }
 
+/**
+ * setPageBufferSize
+ * reserve the page render buffer once, at the first page, instead of growing it per request
+ * buffer is reused for every page and freed when the portal shuts down
+ * @since $dev
+ * @param size_t bytes, 0 grows to the largest page served (default)
+ */
+void WiFiManager::setPageBufferSize(size_t bytes){
+  _pageBufferSize = bytes;
+  _pageReserved   = false;
+}
+
+/**
+ * setPortalLoopBudget
+ * each process()/blocking loop iteration keeps alternating dns and http passes
+ * while requests are being served, up to this many ms, protects watchdog and app timing
+ * @since $dev
+ * @param unsigned long ms budget, default 10, 0 for a single pass
+ */
+void WiFiManager::setPortalLoopBudget(unsigned long ms){
+  _portalLoopBudget = ms;
+}
+
+/**
+ * setWarmRestart
+ * keep web server, dns server, their handlers and the page buffer between portal stops and starts,
+ * servers only stop and start listening, less heap churn when toggling the web portal often
+ * _webservercallback is only called when the server is created (first start or port changed)
+ * @since $dev
+ * @param bool enable default false, servers are destroyed on portal shutdown
+ */
+void WiFiManager::setWarmRestart(bool enable){
+  _warmRestart = enable;
+}
+
+/**
+ * setHttpKeepAlive
+ * keep portal connections open between requests, esp8266 core 3+ only, ignored elsewhere
+ * saves a tcp handshake per request for a single client, but the server serves one connection
+ * at a time, parallel browser sockets, os probes and other clients wait until the kept one
+ * idles out, so keep idleTimeout short if several clients are expected
+ * @since $dev
+ * @param bool          enable      default false
+ * @param unsigned long idleTimeout ms before an idle connection is closed, default 2000
+ * @param uint8_t       maxRequests requests served per connection before it is closed, default 16
+ */
+void WiFiManager::setHttpKeepAlive(bool enable, unsigned long idleTimeout, uint8_t maxRequests){
+  _httpKeepAlive   = enable;
+  _httpIdleTimeout = idleTimeout;
+  _httpMaxRequests = maxRequests;
+  _cpRedirect      = ""; // rebuild cached redirects
+}
+
 
 bool WiFiManager::preloadWiFi(String ssid, String pass){
   _defaultssid = ssid;
@@ -3361,6 +5491,153 @@ String WiFiManager::getWiFiPass(bool persistent){
   return WiFi_psk(persistent);
 } 
 
+#ifdef WM_TRACE
+/**
+ * timeline tracer
+ * spans are recorded into a static buffer with micros() timestamps
+ * buffer is cleared on each autoconnect and portal wifi save, so it holds the last connect timeline
+ * @since $dev
+ */
+void WiFiManager::traceReset(){
+  _traceCount = 0;
+}
+
+uint8_t WiFiManager::traceStart(PGM_P name){
+  if(_traceCount >= WM_TRACE_SIZE) return 0xFF; // full, drop span
+  _trace[_traceCount].name  = name;
+  _trace[_traceCount].start = micros();
+  _trace[_traceCount].end   = 0;
+  return _traceCount++;
+}
+
+void WiFiManager::traceEnd(uint8_t id){
+  if(id >= _traceCount) return; // 0xFF dropped
+  _trace[id].end = micros();
+}
+
+uint8_t WiFiManager::getTraceCount(){
+  return _traceCount;
+}
+
+const wm_trace_span_t* WiFiManager::getTrace(){
+  return _trace;
+}
+
+/**
+ * get trace as text, one span per line
+ * offset from first span (us), duration (us), name
+ * @return String
+ */
+String WiFiManager::getTraceOut(){
+  String out;
+  if(!_traceCount) return out;
+  uint32_t origin = _trace[0].start;
+  for(uint8_t i = 0; i < _traceCount; i++){
+    out += String(_trace[i].start - origin);
+    out += F("\t");
+    if(_trace[i].end) out += String(_trace[i].end - _trace[i].start);
+    else out += F("open");
+    out += F("\t");
+    out += FPSTR(_trace[i].name);
+    out += F("\n");
+  }
+  return out;
+}
+
+void WiFiManager::debugTrace(){
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("[TRACE] offset(us) duration(us) span"));
+  uint32_t origin = _traceCount ? _trace[0].start : 0;
+  for(uint8_t i = 0; i < _traceCount; i++){
+    DEBUG_WM((String)F("[TRACE] ") + String(_trace[i].start - origin) + " " + (_trace[i].end ? String(_trace[i].end - _trace[i].start) : String(F("open"))),FPSTR(_trace[i].name));
+  }
+  #endif
+}
+#endif
+
+/**
+ * current heap stats
+ * @since $dev
+ * @param free     free heap bytes
+ * @param maxBlock largest free block, max allocatable
+ * @param frag     fragmentation % (100 - maxBlock/free)
+ */
+void WiFiManager::getHeapStats(uint32_t &free, uint32_t &maxBlock, uint8_t &frag){
+  #ifdef ESP8266
+    #if defined(ARDUINO_ESP8266_MAJOR) && (ARDUINO_ESP8266_MAJOR > 3 || (ARDUINO_ESP8266_MAJOR == 3 && ARDUINO_ESP8266_MINOR >= 1))
+    ESP.getHeapStats(&free, &maxBlock, &frag); // uint16_t overload deprecated >= 3.1, truncates > 64k
+    #elif defined(ARDUINO_ESP8266_MAJOR)
+    uint16_t max;
+    ESP.getHeapStats(&free, &max, &frag);
+    maxBlock = max;
+    #else
+    free     = ESP.getFreeHeap(); // no heap stats < 2.5.0
+    maxBlock = free;
+    frag     = 0;
+    #endif
+  #elif defined(ESP32)
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+    free     = info.total_free_bytes;
+    maxBlock = info.largest_free_block;
+    frag     = free ? 100 - (maxBlock * 100) / free : 0;
+  #endif
+}
+
+#ifdef WM_HEAPSTATS
+/**
+ * sample heap into lifetime and route high-water marks
+ * @param route wm_route_t, WM_ROUTE_MAX for lifetime only
+ */
+void WiFiManager::heapSample(uint8_t route){
+  uint32_t free, maxBlock;
+  uint8_t  frag;
+  getHeapStats(free, maxBlock, frag);
+
+  wm_heap_stats_t *stats[2] = { &_heapStats[WM_ROUTE_MAX], route < WM_ROUTE_MAX ? &_heapStats[route] : NULL };
+  for(uint8_t i = 0; i < 2; i++){
+    wm_heap_stats_t *st = stats[i];
+    if(!st) continue;
+    if(!st->samples || free < st->minFree) st->minFree = free;
+    if(!st->samples || maxBlock < st->minMaxBlock) st->minMaxBlock = maxBlock;
+    if(frag > st->maxFrag) st->maxFrag = frag;
+    st->samples++;
+  }
+}
+
+const wm_heap_stats_t* WiFiManager::getHeapStatsRoute(uint8_t route){
+  return &_heapStats[route < WM_ROUTE_MAX ? route : WM_ROUTE_MAX];
+}
+
+void WiFiManager::resetHeapStats(){
+  memset(_heapStats, 0, sizeof(_heapStats));
+}
+
+/**
+ * heap stats as text, one line per sampled route
+ * name, min free, min max block, max frag %, samples, tab separated
+ * @return String
+ */
+String WiFiManager::getHeapStatsOut(){
+  String out;
+  for(uint8_t i = 0; i <= WM_ROUTE_MAX; i++){
+    const wm_heap_stats_t &st = _heapStats[i];
+    if(!st.samples) continue;
+    out += FPSTR((PGM_P)pgm_read_ptr(&WM_ROUTE_NAMES[i]));
+    out += '\t';
+    out += String(st.minFree);
+    out += '\t';
+    out += String(st.minMaxBlock);
+    out += '\t';
+    out += String(st.maxFrag);
+    out += '\t';
+    out += String(st.samples);
+    out += '\n';
+  }
+  return out;
+}
+#endif
+
 // DEBUG
 // @todo fix DEBUG_WM(0,0);
 template <typename Generic>
@@ -3383,27 +5660,11 @@ void WiFiManager::DEBUG_WM(wm_debuglevel_t level,Generic text,Genericb textb) {
   if(!_debug || _debugLevel < level) return;
 
   if(_debugLevel >= WM_DEBUG_MAX){
-    #ifdef ESP8266
-    // uint32_t free;
-    // uint16_t max;
-    // uint8_t frag;
-    // ESP.getHeapStats(&free, &max, &frag);// @todo Does not exist in 2.3.0
-    // _debugPort.printf("[MEM] free: %5d | max: %5d | frag: %3d%% \n", free, max, frag); 
-    #elif defined ESP32
-    // total_free_bytes;      ///<  Total free bytes in the heap. Equivalent to multi_free_heap_size().
-    // total_allocated_bytes; ///<  Total bytes allocated to data in the heap.
-    // largest_free_block;    ///<  Size of largest free block in the heap. This is the largest malloc-able size.
-    // minimum_free_bytes;    ///<  Lifetime minimum free heap size. Equivalent to multi_minimum_free_heap_size().
-    // allocated_blocks;      ///<  Number of (variable size) blocks allocated in the heap.
-    // free_blocks;           ///<  Number of (variable size) free blocks in the heap.
-    // total_blocks;          ///<  Total number of (variable size) blocks in the heap.
-    multi_heap_info_t info;
-    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
-    uint32_t free = info.total_free_bytes;
-    uint16_t max  = info.largest_free_block;
-    uint8_t frag = 100 - (max * 100) / free;
-    _debugPort.printf("[MEM] free: %5lu | max: %5u | frag: %3u%% \n", free, max, frag);
-    #endif
+    uint32_t free;
+    uint32_t max;
+    uint8_t frag;
+    getHeapStats(free, max, frag);
+    _debugPort.printf("[MEM] free: %5lu | max: %5lu | frag: %3u%% \n", (unsigned long)free, (unsigned long)max, frag);
   }
 
   _debugPort.print(_debugPrefix);
@@ -3911,7 +6172,8 @@ void WiFiManager::handleUpdate() {
 	DEBUG_WM(WM_DEBUG_VERBOSE,F("<- Handle update"));
   #endif
 	if (captivePortal()) return; // If captive portal redirect instead of displaying the page
-	String page = getHTTPHead(_title, FPSTR(C_update)); // @token options
+	routeStart(WM_ROUTE_UPDATE);
+	String &page = getHTTPHead(_title, FPSTR(C_update)); // @token options
 	String str = FPSTR(HTTP_ROOT_MAIN);
   str.replace(FPSTR(T_t), _title);
 	str.replace(FPSTR(T_v), configPortalActive ? _apName : (getWiFiHostname() + " - " + WiFi.localIP().toString())); // use ip if ap is not active for heading
@@ -3947,6 +6209,9 @@ void WiFiManager::handleUpdating(){
 	HTTPUpload& upload = server->upload();
 
   // UPLOAD START
+  // the whole upload is timed as one ota request, from start to end or abort
+  if (upload.status == UPLOAD_FILE_START) routeStart(WM_ROUTE_OTA);
+
 	if (upload.status == UPLOAD_FILE_START) {
 	  // if(_debug) Serial.setDebugOutput(true);
     uint32_t maxSketchSpace;
@@ -3985,6 +6250,9 @@ void WiFiManager::handleUpdating(){
   // UPLOAD WRITE
   else if (upload.status == UPLOAD_FILE_WRITE) {
 		// Serial.print(".");
+    #ifdef WM_METRICS
+    _metrics.otaBytes += upload.currentSize;
+    #endif
 		if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA Update WRITE ERROR"), Update.getError());
@@ -4013,6 +6281,7 @@ void WiFiManager::handleUpdating(){
     error = true;
   }
   if(error) _configPortalTimeout = _configPortalTimeoutSAV;
+  if (upload.status == UPLOAD_FILE_END || upload.status == UPLOAD_FILE_ABORTED) routeEnd();
 	delay(0);
 }
 
@@ -4021,7 +6290,7 @@ void WiFiManager::handleUpdateDone() {
 	DEBUG_WM(WM_DEBUG_VERBOSE, F("<- Handle update done"));
 	// if (captivePortal()) return; // If captive portal redirect instead of displaying the page
 
-	String page = getHTTPHead(FPSTR(S_options), FPSTR(C_update)); // @token options
+	String &page = getHTTPHead(FPSTR(S_options), FPSTR(C_update)); // @token options
 	String str  = FPSTR(HTTP_ROOT_MAIN);
   str.replace(FPSTR(T_t),_title);
 	str.replace(FPSTR(T_v), configPortalActive ? _apName : WiFi.localIP().toString()); // use ip if ap is not active for heading
@@ -4044,9 +6313,8 @@ void WiFiManager::handleUpdateDone() {
 
 	HTTPSend(page);
 
-	delay(1000); // send page
 	if (!Update.hasError()) {
-		ESP.restart();
+		deferAction(WM_DEFER_REBOOT, 1000); // send page
 	}
 }
 
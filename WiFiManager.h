@@ -21,11 +21,23 @@
 #endif
 
 #include <vector>
+#include <limits.h>
+#include <float.h>
 
 // #define WM_MDNS            // includes MDNS, also set MDNS with sethostname
 // #define WM_FIXERASECONFIG  // use erase flash fix
 // #define WM_ERASE_NVS       // esp32 erase(true) will erase NVS 
 // #define WM_RTC             // esp32 info page will include reset reasons
+// #define WM_TRACE           // record autoconnect timeline spans (us), dump via debugTrace() or /trace
+// #define WM_HEAPSTATS       // track min free heap, max block, fragmentation per route, dump via /heap
+// #define WM_METRICS         // prometheus text /metrics, request latency per route, captive, dns, scan, connect, ota counters
+// #define WM_LATENCY         // ring buffer of per request render/scan/send/total micros, dump via /latency
+// #define WM_PARAMSTORE      // parameter persistence to a FS file, binary journal of changed values, see setParamStore
+// #define WM_CONFIGIO        // json config export/import, GET /config/export, POST /config/import (wifi password only with setShowPassword)
+// #define WM_STREAMFORM      // decode wifisave/paramsave form bodies incrementally into params (esp8266 core 3+ raw handlers)
+// #define WM_DNSRESPONDER    // use built in captive dns responder (batched, AAAA/HTTPS short answers) instead of DNSServer
+// #define WM_WEBSERVER       // web server backend class to use instead of WebServer/ESP8266WebServer, see WM_WebServer
+// #define WM_WEBSERVER_INCLUDE "MyServer.h" // header for WM_WEBSERVER
 
 // #define WM_JSTEST                      // build flag for enabling js xhr tests
 // #define WIFI_MANAGER_OVERRIDE_STRINGS // build flag for using own strings include
@@ -73,6 +85,10 @@
     #include <ESP8266WiFi.h>
     #include <ESP8266WebServer.h>
 
+    #if defined(ARDUINO_ESP8266_MAJOR) && ARDUINO_ESP8266_MAJOR >= 3 && !defined(WM_WEBSERVER)
+        #define WM_HTTPKEEPALIVE // webserver supports http/1.1 keepAlive()
+    #endif
+
     #ifdef WM_MDNS
         #include <ESP8266mDNS.h>
     #endif
@@ -129,8 +145,42 @@
 #else
 #endif
 
+#ifdef WM_WEBSERVER_INCLUDE
+#include WM_WEBSERVER_INCLUDE
+#endif
+
 #include <DNSServer.h>
+
+// streaming form bodies need the esp8266 core 3+ RequestHandler raw() interface
+// a WM_WEBSERVER backend must derive from ESP8266WebServer for it, checked in WiFiManager
+#if defined(WM_STREAMFORM) && !(defined(ESP8266) && defined(ARDUINO_ESP8266_MAJOR) && ARDUINO_ESP8266_MAJOR >= 3)
+    #undef WM_STREAMFORM
+#endif
+
+#ifdef WM_DNSRESPONDER
+#include <WiFiUdp.h>
+#endif
 #include <memory>
+#ifdef WM_WEBSERVER
+#include <type_traits>
+#include <utility>
+
+// WM_WEBSERVER api checks, so a backend missing a call fails at the flag that needs it, see WM_WebServer
+template<typename S, typename = void> struct WM_srvKeepAlive : std::false_type {};
+template<typename S> struct WM_srvKeepAlive<S, decltype(std::declval<S&>().keepAlive(true), void())> : std::true_type {};
+
+template<typename S, typename = void> struct WM_srvClient : std::false_type {};
+template<typename S> struct WM_srvClient<S, decltype((uint32_t)std::declval<S&>().client().localIP(), (uint32_t)std::declval<S&>().client().remoteIP(),
+  std::declval<S&>().client().remotePort(), (bool)std::declval<S&>().client().connected(),
+  std::declval<S&>().client().write((const uint8_t*)0, (size_t)0), std::declval<S&>().client().stop(), void())> : std::true_type {};
+
+template<typename S, typename = void> struct WM_srvChunked : std::false_type {};
+template<typename S> struct WM_srvChunked<S, decltype(std::declval<S&>().setContentLength((size_t)0), std::declval<S&>().sendContent(String()),
+  std::declval<S&>().sendContent((const char*)0, (size_t)0), void())> : std::true_type {};
+#endif
+#ifdef WM_PARAMSTORE
+#include <FS.h>
+#endif
 
 
 // Include wm strings vars
@@ -187,9 +237,66 @@
 // #pragma message "VER_ARDUINO_STR = " WM_STRING(VER_ARDUINO_STR)
 
 #ifndef WIFI_MANAGER_MAX_PARAMS
-    #define WIFI_MANAGER_MAX_PARAMS 5 // params will autoincrement and realloc by this amount when max is reached
+    #define WIFI_MANAGER_MAX_PARAMS 5 // initial params allocation, doubles when max is reached, see reserveParameters
 #endif
 
+#ifdef WM_TRACE
+    #ifndef WM_TRACE_SIZE
+        #define WM_TRACE_SIZE 24 // max timeline spans recorded per autoconnect, extra spans are dropped
+    #endif
+    static_assert(WM_TRACE_SIZE < 255, "WM_TRACE_SIZE must be < 255, 0xFF is the dropped span id");
+    #define WM_TRACE_START(var,name) uint8_t var = traceStart(PSTR(name))
+    #define WM_TRACE_END(var)        traceEnd(var)
+#else
+    // compiled out, no code or ram used
+    #define WM_TRACE_START(var,name)
+    #define WM_TRACE_END(var)
+#endif
+
+#ifdef WM_HEAPSTATS
+    #define WM_HEAP_SAMPLE(route) heapSample(route)
+#else
+    #define WM_HEAP_SAMPLE(route)
+#endif
+
+// heap high-water marks, lowest free and max block, highest fragmentation seen
+typedef struct {
+    uint32_t minFree;
+    uint32_t minMaxBlock;
+    uint8_t  maxFrag;
+    uint32_t samples;
+} wm_heap_stats_t;
+
+#ifdef WM_METRICS
+    #define WM_METRICS_LATENCY_BUCKETS 7 // ms upper bounds 5,20,50,100,250,1000,+Inf
+    #define WM_METRICS_SCAN_BUCKETS    5 // ms upper bounds 1000,2000,4000,8000,+Inf
+    #define WM_METRICS_CONX_CODES      9 // wl_status_t 0-7, last is other (eg. 255 no shield, 254 stopped)
+    #define WM_METRICS_CHUNK           256 // bytes buffered per streamed chunk
+#endif
+
+#ifdef WM_LATENCY
+    #ifndef WM_LATENCY_SIZE
+        #define WM_LATENCY_SIZE 16 // requests kept in latency ring buffer, oldest overwritten
+    #endif
+#endif
+
+// request timing, us, render excludes scan, send is time spent in server send
+typedef struct {
+    uint8_t  route;
+    uint32_t start;  // micros
+    uint32_t scan;
+    uint32_t render;
+    uint32_t send;
+    uint32_t total;
+} wm_latency_t;
+
+// timeline span, start and end are micros(), end is 0 while span is still open
+typedef struct {
+    PGM_P    name;
+    uint32_t start;
+    uint32_t end;
+} wm_trace_span_t;
+
 #define WFM_LABEL_BEFORE 1
 #define WFM_LABEL_AFTER 2
 #define WFM_NO_LABEL 0
@@ -207,7 +314,7 @@ class WiFiManagerParameter {
     WiFiManagerParameter(const char *id, const char *label, const char *defaultValue, int length);
     WiFiManagerParameter(const char *id, const char *label, const char *defaultValue, int length, const char *custom);
     WiFiManagerParameter(const char *id, const char *label, const char *defaultValue, int length, const char *custom, int labelPlacement);
-    ~WiFiManagerParameter();
+    virtual ~WiFiManagerParameter();
     // WiFiManagerParameter& operator=(const WiFiManagerParameter& rhs);
 
     const char *getID() const;
@@ -217,10 +324,19 @@ class WiFiManagerParameter {
     int         getValueLength() const;
     int         getLabelPlacement() const;
     virtual const char *getCustomHTML() const;
+    virtual const char *getFormValue() const; // value rendered in the form input, getValue by default
+    virtual PGM_P       getFormTemplate() const; // field template, HTTP_FORM_PARAM by default
+    virtual bool        validate(const char *value) const; // checked on param save, invalid values are not stored
     void        setValue(const char *defaultValue, int length);
+    const char *getGroup() const;
+    void        setGroup(const char *group); // section of the param page, NULL for ungrouped
+    bool        isChanged() const; // value changed by the last param save
+    // called on param save when this value changed, with the previous value
+    void        setChangeCallback(std::function<void(WiFiManagerParameter*, const char*)> func);
 
   protected:
     void init(const char *id, const char *label, const char *defaultValue, int length, const char *custom, int labelPlacement);
+    virtual void parse(); // value was set, typed params update their native value
 
     WiFiManagerParameter& operator=(const WiFiManagerParameter&);
     const char *_id;
@@ -230,9 +346,128 @@ class WiFiManagerParameter {
     int         _labelPlacement;
   
     const char *_customHTML;
+    std::shared_ptr<char> _pool; // set if _value is in a WiFiManager value pool
+    bool        _dirty = false; // changed by param save, not yet stored
+    const char *_group = NULL;
+    bool        _changed = false;
+    bool        _posted  = false; // value was posted in current save
+    char        _lengthText[7] = "0"; // _length as text, for rendering
+    std::function<void(WiFiManagerParameter*, const char*)> _changecallback;
     friend class WiFiManager;
 };
 
+/**
+ * Typed parameters
+ * value is parsed once when set or saved and read natively, save rejects out of range or malformed values,
+ * rendered with a matching input type
+ */
+class WiFiManagerParameterInt : public WiFiManagerParameter {
+  public:
+    WiFiManagerParameterInt(const char *id, const char *label, long value, long min = LONG_MIN, long max = LONG_MAX);
+
+    long        getInt() const;
+    void        setInt(long value);
+    const char *getCustomHTML() const override;
+    bool        validate(const char *value) const override;
+
+  protected:
+    void        parse() override;
+    long        _int;
+    long        _min;
+    long        _max;
+    String      _attr;
+};
+
+class WiFiManagerParameterFloat : public WiFiManagerParameter {
+  public:
+    WiFiManagerParameterFloat(const char *id, const char *label, float value, float min = -FLT_MAX, float max = FLT_MAX, uint8_t decimals = 2);
+
+    float       getFloat() const;
+    void        setFloat(float value);
+    const char *getCustomHTML() const override;
+    bool        validate(const char *value) const override;
+
+  protected:
+    void        parse() override;
+    float       _float;
+    float       _min;
+    float       _max;
+    uint8_t     _decimals;
+    String      _attr;
+};
+
+class WiFiManagerParameterBool : public WiFiManagerParameter {
+  public:
+    WiFiManagerParameterBool(const char *id, const char *label, bool value);
+
+    bool        getBool() const;
+    void        setBool(bool value);
+    const char *getCustomHTML() const override;
+    const char *getFormValue() const override;
+
+  protected:
+    void        parse() override;
+    bool        _bool;
+};
+
+// value is one of options, rendered as a select, options are not copied and must stay in scope
+class WiFiManagerParameterEnum : public WiFiManagerParameter {
+  public:
+    WiFiManagerParameterEnum(const char *id, const char *label, const char * const *options, uint8_t count, uint8_t selected = 0);
+
+    uint8_t     getIndex() const;
+    void        setIndex(uint8_t index);
+    const char *getCustomHTML() const override;
+    PGM_P       getFormTemplate() const override;
+    bool        validate(const char *value) const override;
+
+  protected:
+    void        parse() override;
+    int         find(const char *value) const;
+    const char * const *_options;
+    uint8_t     _count;
+    uint8_t     _index;
+    String      _optionsHTML;
+};
+
+#ifdef WM_DNSRESPONDER
+
+#ifndef WM_DNS_BATCH
+    #define WM_DNS_BATCH 16 // max queries answered per processNextRequest, bounds loop time on floods
+#endif
+
+/**
+ * Captive portal dns responder
+ * answers every A query with the portal ip from a prebuilt answer record,
+ * AAAA and HTTPS (and other types) get an empty NOERROR answer so clients fall back to A fast,
+ * drains all pending queries per call instead of one
+ */
+class WiFiManagerDNS {
+  public:
+    WiFiManagerDNS();
+    ~WiFiManagerDNS();
+
+    bool     start(const uint16_t port, const IPAddress &resolvedIP);
+    void     stop();
+    void     processNextRequest(); // process all pending queries, up to WM_DNS_BATCH
+    void     setTTL(const uint32_t ttl);
+    uint32_t getQueriesServed();
+    uint32_t getQueriesDropped();
+
+  protected:
+    void     buildAnswer();
+
+    WiFiUDP  _udp;
+    uint32_t _resolvedIP  = 0;
+    uint32_t _ttl         = 60;
+    uint32_t _served      = 0;
+    uint32_t _dropped     = 0;
+    uint8_t  _answer[16];  // prebuilt A record, name pointer to question
+    uint8_t  _buffer[512]; // udp dns max message size, reused for the response
+};
+
+#endif
+
 
     // debugging
     typedef enum {
@@ -244,6 +479,55 @@ class WiFiManagerParameter {
         WM_DEBUG_MAX       = 5  // MAX extra dev auditing, var dumps etc (MAX+1 will print timing,mem and frag info)
     } wm_debuglevel_t;
 
+    // portal routes and heavy operations, for per route stats, names in WM_ROUTE_NAMES
+    // the stats routes themselves (/trace /heap /latency /metrics) are not sampled, they would skew what they report
+    typedef enum {
+        WM_ROUTE_ROOT      = 0,
+        WM_ROUTE_WIFI      = 1,
+        WM_ROUTE_WIFISAVE  = 2,
+        WM_ROUTE_PARAM     = 3,
+        WM_ROUTE_PARAMSAVE = 4,
+        WM_ROUTE_INFO      = 5,
+        WM_ROUTE_STATUS    = 6,
+        WM_ROUTE_EXIT      = 7,
+        WM_ROUTE_RESTART   = 8,
+        WM_ROUTE_ERASE     = 9,
+        WM_ROUTE_CLOSE     = 10,
+        WM_ROUTE_UPDATE    = 11,
+        WM_ROUTE_NOTFOUND  = 12,
+        WM_ROUTE_SCAN      = 13, // wifi scan
+        WM_ROUTE_CONNECT   = 14, // sta connect
+        WM_ROUTE_OTA       = 15, // ota upload
+        WM_ROUTE_CONFIGEXPORT = 16, // WM_CONFIGIO
+        WM_ROUTE_CONFIGIMPORT = 17, // WM_CONFIGIO
+        WM_ROUTE_MAX       = 18  // none, lifetime stats index
+    } wm_route_t;
+
+    #ifdef WM_METRICS
+    // metrics counters, histogram buckets are non cumulative
+    typedef struct {
+        uint32_t requests[WM_ROUTE_MAX];                        // per wm_route_t
+        uint32_t latencySum[WM_ROUTE_MAX];                      // ms, per wm_route_t
+        uint32_t latency[WM_ROUTE_MAX][WM_METRICS_LATENCY_BUCKETS]; // per wm_route_t
+        uint32_t captiveRedirects;
+        uint32_t captiveProbes;
+        uint32_t scans;
+        uint32_t scanSum;                                       // ms
+        uint32_t scan[WM_METRICS_SCAN_BUCKETS];
+        uint32_t connects[WM_METRICS_CONX_CODES];               // attempts per result
+        uint32_t otaBytes;
+        unsigned long portalStart;                              // millis
+    } wm_metrics_t;
+    #endif
+
+    // portal actions deferred out of http handlers, run from processConfigPortal, dropped on portal shutdown
+    // the server is still synchronous, one client is handled at a time, there is no concurrent/async server mode
+    typedef enum {
+        WM_DEFER_NONE      = 0,
+        WM_DEFER_EXIT      = 1, // abort portal
+        WM_DEFER_REBOOT    = 2  // restart esp
+    } wm_defer_t;
+
 class WiFiManager
 {
   public:
@@ -256,6 +540,10 @@ class WiFiManager
     boolean       autoConnect();
     boolean       autoConnect(char const *apName, char const *apPassword = NULL);
 
+    // fast path for deep sleep wakes, single connect using saved creds + cached channel/bssid (and static ip if set)
+    // falls back to autoConnect if not connected within setFastConnectTimeout
+    boolean       autoConnectFast(int32_t channel, const uint8_t *bssid, char const *apName = NULL, char const *apPassword = NULL);
+
     //manually start the config portal, autoconnect does this automatically on connect failure
     boolean       startConfigPortal(); // auto generates apname
     boolean       startConfigPortal(char const *apName, char const *apPassword = NULL);
@@ -298,6 +586,29 @@ class WiFiManager
     // returns the Parameters Count
     int           getParametersCount();
 
+    // returns the added parameter with id, NULL if none
+    WiFiManagerParameter* getParameter(const char *id);
+
+    // allocate for count parameters up front, returns false on failure
+    bool          reserveParameters(int count);
+
+    // compact all parameter values into one heap block, returns false on failure
+    bool          packParameters();
+
+    // pack parameter values on portal start
+    void          setParamPool(bool enable);
+
+    #ifdef WM_PARAMSTORE
+    // persist parameters to file on fs, changed values are stored on param save
+    void          setParamStore(fs::FS &fs, const char *path = "/wmparams.bin");
+    // load stored values into added parameters, call after addParameter
+    bool          loadParameters();
+    // store changed parameter values, compacts the journal when it grows
+    bool          saveParameters();
+    // rewrite store with current values only
+    bool          compactParameters();
+    #endif
+
     // SET CALLBACKS
 
     //called after AP mode and config portal has started
@@ -321,6 +632,12 @@ class WiFiManager
     //called when saving either params-in-wifi or params page
     void          setSaveParamsCallback( std::function<void()> func );
 
+    //called on params save for each param whose value changed, with the previous value, filter by getID() or getGroup()
+    void          setParamChangeCallback( std::function<void(WiFiManagerParameter*, const char*)> func );
+
+    // params changed by the last params save
+    int           getParamsChangedCount();
+
     //called just before doing OTA update
     void          setPreOtaUpdateCallback( std::function<void()> func );
 
@@ -341,6 +658,9 @@ class WiFiManager
     
     //sets timeout for which to attempt connecting on saves, useful if there are bugs in esp waitforconnectloop
     void          setSaveConnectTimeout(unsigned long seconds);
+
+    //sets deadline for autoConnectFast before falling back to autoConnect, in ms
+    void          setFastConnectTimeout(unsigned long ms);
     
     // lets you disable automatically connecting after save from webportal
     void          setSaveConnect(bool connect = true);
@@ -491,6 +811,19 @@ class WiFiManager
     // set port of webserver, 80
     void          setHttpPort(uint16_t port);
 
+    // http keep-alive for portal requests (esp8266 core 3+), connection closed after idleTimeout ms or maxRequests
+    // off by default, the server handles one client at a time, other clients wait while a kept connection idles
+    void          setHttpKeepAlive(bool enable, unsigned long idleTimeout = 2000, uint8_t maxRequests = 16);
+
+    // keep server instances and handlers across portal restarts, stop and start listening only
+    void          setWarmRestart(bool enable);
+
+    // reserve page render buffer bytes once, reused for all pages, 0 grows to largest page
+    void          setPageBufferSize(size_t bytes);
+
+    // ms per portal loop iteration to keep serving dns and http while there is work, 0 for one pass
+    void          setPortalLoopBudget(unsigned long ms);
+
     // check if config portal is active (true)
     bool          getConfigPortalActive();
     
@@ -503,10 +836,82 @@ class WiFiManager
     // get hostname helper
     String        getWiFiHostname();
 
+    #ifdef WM_TRACE
+    // timeline tracer, spans of the last autoconnect
+    void          traceReset();
+    uint8_t       getTraceCount();
+    const wm_trace_span_t* getTrace();
+    String        getTraceOut();
+    void          debugTrace();
+    #endif
+
+    // current free heap, largest free block and fragmentation %
+    void          getHeapStats(uint32_t &free, uint32_t &maxBlock, uint8_t &frag);
+
+    #ifdef WM_HEAPSTATS
+    // heap high-water marks, per wm_route_t, WM_ROUTE_MAX for lifetime
+    const wm_heap_stats_t* getHeapStatsRoute(uint8_t route = WM_ROUTE_MAX);
+    void          resetHeapStats();
+    String        getHeapStatsOut();
+    #endif
+
+    #ifdef WM_CONFIGIO
+    // wifi credentials and param values as json, and apply such a document (all or nothing)
+    // ssid/pass are only applied while the config or web portal runs, which connects with them
+    String        getConfigOut(bool credentials = true);
+    bool          setConfig(const char *json, String &error);
+    #endif
+
+    #ifdef WM_LATENCY
+    // latency ring buffer, index 0 is oldest
+    uint8_t       getLatencyCount();
+    const wm_latency_t* getLatency(uint8_t index);
+    String        getLatencyOut();
+    #endif
+
+    #ifdef WM_METRICS
+    const wm_metrics_t* getMetrics();
+    void          resetMetrics();
+    #endif
+
 
-    std::unique_ptr<DNSServer>        dnsServer;
+    #ifdef WM_DNSRESPONDER
+        using WM_DNSServer = WiFiManagerDNS;
+    #else
+        using WM_DNSServer = DNSServer;
+    #endif
 
-    #if defined(ESP32) && defined(WM_WEBSERVERSHIM)
+    std::unique_ptr<WM_DNSServer>     dnsServer;
+
+    /**
+     * web server backend
+     * override with WM_WEBSERVER, the class only needs the subset of the
+     * WebServer/ESP8266WebServer api the portal uses:
+     * ctor(port), begin(), stop(), handleClient(), client() (localIP, write, stop)
+     * on(uri, fn), on(uri, method, fn, uploadfn), onNotFound(fn), upload() (HTTPUpload)
+     * uri(), method(), hostHeader(), args(), arg(name|i), argName(i), hasArg(name)
+     * sendHeader(name, value, first), send(code, type, content), send_P(code, type, content)
+     * authenticate(user, pass), requestAuthentication()
+     * and per flag, checked at compile time:
+     * WM_HTTPKEEPALIVE keepAlive(bool), client() (remoteIP, remotePort, connected), not auto enabled for WM_WEBSERVER
+     * WM_METRICS       setContentLength(len), sendContent(content), sendContent(buf, len)
+     * WM_STREAMFORM    derive from ESP8266WebServer, addHandler(RequestHandler*) with raw() (esp8266 core 3+)
+     * WM_CONFIGIO      arg("plain") holding the request body
+     */
+    #if defined(WM_WEBSERVER)
+        using WM_WebServer = WM_WEBSERVER;
+        static_assert(WM_srvClient<WM_WebServer>::value, "WM_WEBSERVER needs client() with localIP, remoteIP, remotePort, connected, write, stop");
+        #ifdef WM_HTTPKEEPALIVE
+        static_assert(WM_srvKeepAlive<WM_WebServer>::value, "WM_HTTPKEEPALIVE needs WM_WEBSERVER keepAlive(bool)");
+        #endif
+        #ifdef WM_METRICS
+        static_assert(WM_srvChunked<WM_WebServer>::value, "WM_METRICS needs WM_WEBSERVER setContentLength(len), sendContent(content), sendContent(buf, len)");
+        #endif
+        #ifdef WM_STREAMFORM
+        static_assert(std::is_base_of<ESP8266WebServer, WM_WebServer>::value, "WM_STREAMFORM needs a WM_WEBSERVER derived from ESP8266WebServer");
+        static_assert(std::is_member_function_pointer<decltype(&RequestHandler::raw)>::value, "WM_STREAMFORM needs RequestHandler::raw(), esp8266 core 3+");
+        #endif
+    #elif defined(ESP32) && defined(WM_WEBSERVERSHIM)
         using WM_WebServer = WebServer;
     #else
         using WM_WebServer = ESP8266WebServer;
@@ -551,6 +956,7 @@ class WiFiManager
     unsigned long _configPortalTimeout    = 0; // ms close config portal loop if set (depending on  _cp/webClientCheck options)
     unsigned long _connectTimeout         = 0; // ms stop trying to connect to ap if set
     unsigned long _saveTimeout            = 0; // ms stop trying to connect to ap on saves, in case bugs in esp waitforconnectresult
+    unsigned long _fastConnectTimeout     = 3000; // ms autoConnectFast deadline before falling back to autoConnect
     
     WiFiMode_t    _usermode               = WIFI_STA; // Default user mode
     String        _wifissidprefix         = FPSTR(S_ssidpre); // auto apname prefix prefix+chipid
@@ -563,6 +969,21 @@ class WiFiManager
     int32_t       _apChannel              = 0; // default channel to use for ap, 0 for auto
     bool          _apHidden               = false; // store softap hidden value
     uint16_t      _httpPort               = 80; // port for webserver
+    String        _page;                        // reusable page render buffer
+    size_t        _pageBufferSize         = 0;  // bytes to reserve for _page, 0 to grow
+    bool          _pageReserved           = false;
+    uint32_t      _cpLocIP                = 0;  // ip the cached captive redirect was built for
+    uint16_t      _cpLocPort              = 0;  // port the cached captive redirect was built for
+    String        _cpLoc;                       // cached captive host, ip[:port]
+    String        _cpRedirect;                  // cached raw 302 response to _cpLoc
+    String        _cpRedirectKA;                // cached raw 302 response to _cpLoc, keep-alive
+    bool          _httpKeepAlive          = false; // keep portal connections open between requests, if supported, opt in
+    unsigned long _httpIdleTimeout        = 2000; // ms, close kept alive connection when idle
+    uint8_t       _httpMaxRequests        = 16; // requests per connection before closing
+    uint8_t       _httpConnRequests       = 0;  // requests served on current connection
+    uint32_t      _httpConnIP             = 0;  // current connection remote ip
+    uint16_t      _httpConnPort           = 0;  // current connection remote port
+    unsigned long _httpLastRequest        = 0;  // millis of last request on current connection
     // uint8_t       _retryCount             = 0; // counter for retries, probably not needed if synchronous
     uint8_t       _connectRetries         = 1; // number of sta connect retries, force reconnect, wait loop (connectimeout) does not always work and first disconnect bails
     bool          _aggresiveReconn        = false; // use an agrressive reconnect strategy, WILL delay conxs
@@ -575,6 +996,46 @@ class WiFiManager
     static uint8_t _lastconxresulttmp; // tmp var for esp32 callback
     #endif
 
+    #ifdef WM_TRACE
+    static wm_trace_span_t _trace[WM_TRACE_SIZE]; // static timeline buffer
+    static uint8_t _traceCount;
+    uint8_t       traceStart(PGM_P name);
+    void          traceEnd(uint8_t id);
+    #endif
+
+    uint8_t       _route = WM_ROUTE_MAX; // route of request being handled
+    uint32_t      _httpServed = 0; // responses started, used to detect http work per loop pass
+    unsigned long _portalLoopBudget = 10; // ms, see setPortalLoopBudget
+    bool          _warmRestart = false; // keep servers on shutdown, see setWarmRestart
+    uint16_t      _serverPort  = 0; // port server was created with
+    void          routeStart(uint8_t route);
+    void          routeEnd();
+
+    #ifdef WM_HEAPSTATS
+    wm_heap_stats_t _heapStats[WM_ROUTE_MAX + 1] = {}; // per route, lifetime at WM_ROUTE_MAX
+    void          heapSample(uint8_t route);
+    #endif
+
+    #if defined(WM_METRICS) || defined(WM_LATENCY)
+    unsigned long _routeStart = 0; // micros, request being handled
+    #endif
+
+    #ifdef WM_LATENCY
+    wm_latency_t  _latency[WM_LATENCY_SIZE] = {};
+    uint8_t       _latencyHead  = 0; // next write
+    uint8_t       _latencyCount = 0;
+    unsigned long _routeRendered = 0; // micros, page rendered and send started
+    unsigned long _routeScan     = 0; // us spent in blocking scans this request
+    #endif
+
+    #ifdef WM_METRICS
+    wm_metrics_t  _metrics = {};
+    void          metricsOut(char *buf, size_t &len, PGM_P fmt, ...);
+    void          metricsFlush(char *buf, size_t &len);
+    void          metricsScan(uint32_t ms);
+    void          metricsHistogram(char *buf, size_t &len, PGM_P name, PGM_P label, const uint16_t *bounds, const uint32_t *buckets, uint8_t count, uint32_t sum);
+    #endif
+
     #ifndef WL_STATION_WRONG_PASSWORD
     uint8_t WL_STATION_WRONG_PASSWORD     = 7; // @kludge define a WL status for wrong password
     #endif
@@ -681,16 +1142,73 @@ protected:
     void          handleReset();
 
     void          handleExit();
+    void          deferAction(uint8_t action, unsigned long ms);
+    void          processDeferred();
     void          handleClose();
     // void          handleErase();
     void          handleErase(boolean opt);
     void          handleParam();
     void          handleWiFiStatus();
-    void          handleRequest();
+    void          handleRequest(uint8_t route = WM_ROUTE_MAX);
+    bool          HTTPKeepAlive();
     void          handleParamSave();
-    void          doParamSave();
+    void          doParamSave(int group = -1);
+    void          paramSaveStart();
+    void          paramSaveValue(WiFiManagerParameter *p, const char *value);
+    void          paramSaveEnd();
+    std::vector<std::pair<WiFiManagerParameter*, String>> _paramsOld; // previous values of changed params, for change callbacks
+
+    #ifdef WM_STREAMFORM
+    friend class WiFiManagerFormHandler;
+    void          formRaw(HTTPRaw &raw);
+    void          formChar(char c);
+    void          formField();
+    void          formEnd();
+    void          formRollback();
+    void          paramRestore(WiFiManagerParameter *p);
+    bool          _formStreamed = false; // current request body was streamed, see WiFiManagerFormHandler
+    bool          _formParams   = false; // streamed fields are stored in params
+    int           _formGroup    = -1; // posted param group, -1 all
+    const char*   _formGroupName = NULL;
+    char          _formName[48];
+    uint8_t       _formNameLen  = 0;
+    std::unique_ptr<char[]> _formValue;
+    size_t        _formValueMax = 0;
+    size_t        _formValueLen = 0;
+    bool          _formInValue  = false;
+    uint8_t       _formHex      = 0; // percent escape digits left
+    uint8_t       _formHexVal   = 0;
+    std::vector<std::pair<String, String>> _formArgs; // streamed fields that are not params
+    #endif
+    std::vector<const char*> getParamGroups();
+    int           getParamGroupArg(const std::vector<const char*> &groups, const char *arg = NULL);
+    void          indexArgs();
+    int           argIndex(const char *name);
+    int           paramArgIndex(int i);
+    String        argValue(int idx);
+    String        argValue(const __FlashStringHelper *name);
+    #ifdef WM_TRACE
+    void          handleTrace();
+    #endif
+    #ifdef WM_HEAPSTATS
+    void          handleHeap();
+    #endif
+    #ifdef WM_METRICS
+    void          handleMetrics();
+    #endif
+    #ifdef WM_LATENCY
+    void          handleLatency();
+    #endif
+    #ifdef WM_CONFIGIO
+    void          handleConfigExport();
+    void          handleConfigImport();
+    #endif
 
     boolean       captivePortal();
+    boolean       captivePortalProbe();
+    boolean       dispatchRoute();
+    const String& captivePortalLoc();
+    void          captivePortalRedirect();
     boolean       configPortalHasTimeout();
     uint8_t       processConfigPortal();
     void          stopCaptivePortal();
@@ -755,11 +1273,12 @@ protected:
     #endif
 
     // output helpers
-    String        getParamOut();
+    void          getParamOut(String &page, const char *group = NULL, bool grouped = false);
+    void          getParamItemOut(String &page, PGM_P tpl, WiFiManagerParameter *p, const char *paramId);
     String        getIpForm(String id, String title, String value);
-    String        getScanItemOut();
+    void          getScanItemOut(String &page);
     String        getStaticOut();
-    String        getHTTPHead(String title, String classes = "");
+    String&       getHTTPHead(String title, String classes = "");
     String        getHTTPEnd();
     String        getMenuOut();
     //helpers
@@ -776,6 +1295,11 @@ protected:
     boolean       reset               = false;
     boolean       configPortalActive  = false;
 
+    uint8_t       _deferAction        = WM_DEFER_NONE; // pending deferred action
+    unsigned long _deferStart         = 0; // millis deferred action was requested
+    unsigned long _deferDelay         = 0; // ms to keep serving before running deferred action
+    unsigned long _connectDelayStart  = 0; // millis save was seen, for non blocking _cpclosedelay
+
 
     // these are state flags for portal mode, we are either in webportal mode(STA) or configportal mode(AP)
     // these are mutually exclusive as STA+AP mode is not supported due to channel restrictions and stability
@@ -792,6 +1316,24 @@ protected:
     int         _paramsCount          = 0;
     int         _max_params;
     WiFiManagerParameter** _params    = NULL;
+    uint16_t*   _paramSlots           = NULL; // param index+1 by id hash
+    uint16_t    _paramSlotsSize       = 0;
+    void        indexParameter(int i);
+    bool        _paramPool            = false; // pack values on portal start, see setParamPool
+
+    #ifdef WM_PARAMSTORE
+    fs::FS*     _paramFS              = NULL;
+    const char* _paramPath            = NULL;
+    uint16_t    _paramRecords         = 0; // records in store journal
+    #endif
+
+    // posted args index, built once per request, see indexArgs
+    uint16_t*   _argSlots             = NULL; // arg index+1 by name hash
+    uint16_t    _argSlotsSize         = 0;
+    uint16_t    _argSlotsMask         = 0;
+    uint16_t*   _argParams            = NULL; // arg index+1 by param_<n>
+    int         _argParamsSize        = 0;
+    bool        _argsIndexed          = false;
 
     boolean _debug  = true;
     String _debugPrefix = FPSTR(S_debugPrefix);
@@ -842,6 +1384,8 @@ protected:
     std::function<void()> _presavewificallback;
     std::function<void()> _presaveparamscallback;
     std::function<void()> _saveparamscallback;
+    std::function<void(WiFiManagerParameter*, const char*)> _paramchangecallback;
+    int           _paramsChanged = 0;
     std::function<void()> _resetcallback;
     std::function<void()> _preotaupdatecallback;
     std::function<void()> _configportaltimeoutcallback;
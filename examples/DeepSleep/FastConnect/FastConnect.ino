@@ -0,0 +1,71 @@
+/**
+ * FastConnect.ino
+ * example of autoConnectFast for deep sleep wake cycles
+ * channel and bssid of the last good connection are cached in rtc memory,
+ * so each wake is a single connect instead of the full autoConnect flow
+ */
+#include <WiFiManager.h> // https://github.com/tzapu/WiFiManager
+
+#define SLEEP_US 300e6 // 5 minutes
+
+struct {
+  uint32_t crc;
+  int32_t  channel;
+  uint8_t  bssid[6];
+} rtcCache;
+
+#ifdef ESP32
+RTC_DATA_ATTR uint8_t rtcStore[sizeof(rtcCache)];
+#endif
+
+uint32_t cacheCrc(){
+  uint32_t crc = 0x811C9DC5;
+  const uint8_t *p = (const uint8_t*)&rtcCache.channel;
+  for(size_t i = 0; i < sizeof(rtcCache) - sizeof(rtcCache.crc); i++) crc = (crc ^ p[i]) * 0x01000193;
+  return crc;
+}
+
+bool readCache(){
+  #ifdef ESP8266
+  ESP.rtcUserMemoryRead(0, (uint32_t*)&rtcCache, sizeof(rtcCache));
+  #else
+  memcpy(&rtcCache, rtcStore, sizeof(rtcCache));
+  #endif
+  return rtcCache.crc == cacheCrc();
+}
+
+void writeCache(){
+  rtcCache.channel = WiFi.channel();
+  memcpy(rtcCache.bssid, WiFi.BSSID(), 6);
+  rtcCache.crc = cacheCrc();
+  #ifdef ESP8266
+  ESP.rtcUserMemoryWrite(0, (uint32_t*)&rtcCache, sizeof(rtcCache));
+  #else
+  memcpy(rtcStore, &rtcCache, sizeof(rtcCache));
+  #endif
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  WiFiManager wm;
+  // static ip skips dhcp, the biggest win after channel/bssid
+  // wm.setSTAStaticIPConfig(IPAddress(10,0,1,99), IPAddress(10,0,1,1), IPAddress(255,255,255,0));
+  wm.setFastConnectTimeout(2000); // ms before falling back to autoConnect
+  wm.setConfigPortalTimeout(120);
+
+  bool res;
+  if(readCache()) res = wm.autoConnectFast(rtcCache.channel, rtcCache.bssid, "AutoConnectAP");
+  else res = wm.autoConnect("AutoConnectAP");
+
+  if(res){
+    writeCache();
+    Serial.println("connected, doing work");
+    // send sensor data here
+  }
+
+  ESP.deepSleep(SLEEP_US);
+}
+
+void loop() {
+}
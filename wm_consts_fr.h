@@ -62,6 +62,63 @@ const char R_erase[]              PROGMEM = "/erase";
 const char R_status[]             PROGMEM = "/status";
 const char R_update[]             PROGMEM = "/update";
 const char R_updatedone[]         PROGMEM = "/u";
+const char R_trace[]              PROGMEM = "/trace";
+const char R_heap[]               PROGMEM = "/heap";
+const char R_metrics[]            PROGMEM = "/metrics";
+const char R_latency[]            PROGMEM = "/latency";
+const char R_configexport[]       PROGMEM = "/config/export";
+const char R_configimport[]       PROGMEM = "/config/import";
+
+
+// heap stats names, in wm_route_t order
+const char S_route_notfound[]     PROGMEM = "404";
+const char S_route_scan[]         PROGMEM = "scan";
+const char S_route_connect[]      PROGMEM = "connect";
+const char S_route_ota[]          PROGMEM = "ota";
+const char S_route_all[]          PROGMEM = "lifetime";
+const char * const WM_ROUTE_NAMES[] PROGMEM = {
+    R_root, R_wifi, R_wifisave, R_param, R_paramsave, R_info, R_status, R_exit, R_restart, R_erase, R_close, R_update,
+    S_route_notfound, S_route_scan, S_route_connect, S_route_ota, R_configexport, R_configimport, S_route_all
+};
+
+// Captive portal OS connectivity probes, answered from this table without render or wifiscan
+// when captive they are redirected to the portal, else they get the expected "online" response
+const char P_generate204[]        PROGMEM = "/generate_204";       // android, chrome
+const char P_gen204[]             PROGMEM = "/gen_204";            // android
+const char P_hotspotdetect[]      PROGMEM = "/hotspot-detect.html"; // apple
+const char P_applesuccess[]       PROGMEM = "/library/test/success.html"; // apple legacy
+const char P_connecttest[]        PROGMEM = "/connecttest.txt";    // windows 10+
+const char P_ncsi[]               PROGMEM = "/ncsi.txt";           // windows legacy
+const char P_successtxt[]         PROGMEM = "/success.txt";        // firefox
+const char P_canonical[]          PROGMEM = "/canonical.html";     // firefox
+const char P_kindle[]             PROGMEM = "/kindle-wifi/wifistub.html"; // kindle
+
+const char B_applesuccess[]       PROGMEM = "<HTML><HEAD><TITLE>Success</TITLE></HEAD><BODY>Success</BODY></HTML>";
+const char B_connecttest[]        PROGMEM = "Microsoft Connect Test";
+const char B_ncsi[]               PROGMEM = "Microsoft NCSI";
+const char B_successtxt[]         PROGMEM = "success\n";
+const char B_canonical[]          PROGMEM = "<meta http-equiv=\"refresh\" content=\"0;url=https://support.mozilla.org/kb/captive-portal\"/>";
+const char B_kindle[]             PROGMEM = "<html><body>81ce4465-7167-4dcb-835b-dcc9e44c112a</body></html>";
+
+typedef struct {
+    PGM_P    path;
+    uint16_t code; // online response code
+    PGM_P    body; // online response body, NULL for none
+    bool     text; // body is text/plain, else text/html
+} wm_probe_t;
+
+const wm_probe_t WM_PROBES[] PROGMEM = {
+    {P_generate204,   204, NULL,           true},
+    {P_gen204,        204, NULL,           true},
+    {P_hotspotdetect, 200, B_applesuccess, false},
+    {P_applesuccess,  200, B_applesuccess, false},
+    {P_connecttest,   200, B_connecttest,  true},
+    {P_ncsi,          200, B_ncsi,         true},
+    {P_successtxt,    200, B_successtxt,   true},
+    {P_canonical,     200, B_canonical,    false},
+    {P_kindle,        200, B_kindle,       false}
+};
+const uint8_t _numprobes = (sizeof(WM_PROBES) / sizeof(wm_probe_t));
 
 
 // Classes
@@ -110,8 +167,13 @@ const char T_h[]                  PROGMEM = "{h}"; // @token h
 const char HTTP_HEAD_CL[]         PROGMEM = "Content-Length";
 const char HTTP_HEAD_CT[]         PROGMEM = "text/html";
 const char HTTP_HEAD_CT2[]        PROGMEM = "text/plain";
+const char HTTP_HEAD_CT_METRICS[] PROGMEM = "text/plain; version=0.0.4"; // prometheus text format
+const char HTTP_HEAD_CT_JSON[]    PROGMEM = "application/json";
 const char HTTP_HEAD_CORS[]       PROGMEM = "Access-Control-Allow-Origin";
 const char HTTP_HEAD_CORS_ALLOW_ALL[]  PROGMEM = "*";
+const char HTTP_302_START[]       PROGMEM = "HTTP/1.1 302 Found\r\nLocation: http://"; // captive redirect, prebuilt once per ip/port
+const char HTTP_302_END[]         PROGMEM = "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+const char HTTP_302_END_KA[]      PROGMEM = "\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
 
 const char * const WIFI_STA_STATUS[] PROGMEM
 {
@@ -78,6 +78,9 @@ const char HTTP_FORM_END[]         PROGMEM = "<br/><br/><button type='submit'>Sa
 const char HTTP_FORM_LABEL[]       PROGMEM = "<label for='{i}'>{t}</label>";
 const char HTTP_FORM_PARAM_HEAD[]  PROGMEM = "<hr><br/>";
 const char HTTP_FORM_PARAM[]       PROGMEM = "<br/><input id='{i}' name='{n}' maxlength='{l}' value='{v}' {c}>\n"; // do not remove newline!
+const char HTTP_FORM_SELECT[]      PROGMEM = "<br/><select id='{i}' name='{n}'>{c}</select>\n"; // {c} is the option list
+const char HTTP_PARAM_GROUP[]      PROGMEM = "<form action='/param' method='get'><input type='hidden' name='wm_g' value='{i}'><button{c}>{t}</button></form><br/>\n";
+const char HTTP_FORM_GROUP[]       PROGMEM = "<input type='hidden' name='wm_g' value='{i}'>"; // S_paramgroup, first in form, streamed saves filter the params after it
 
 const char HTTP_SCAN_LINK[]        PROGMEM = "<br/><form action='/wifi?refresh=1' method='POST'><button name='refresh' value='1'>Refresh</button></form>";
 const char HTTP_SAVED[]            PROGMEM = "<div class='msg'>Saving Credentials<br/>Trying to connect ESP to network.<br />If it fails reconnect to AP to try again</div>";
@@ -262,6 +265,7 @@ const char S_uri[]                PROGMEM = "URI: ";
 const char S_method[]             PROGMEM = "\nMethod: ";
 const char S_args[]               PROGMEM = "\nArguments: ";
 const char S_parampre[]           PROGMEM = "param_";
+const char S_paramgroup[]         PROGMEM = "wm_g"; // reserved field and param id, posted param group
 
 // debug strings
 const char D_HR[]                 PROGMEM = "--------------------";